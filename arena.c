@@ -0,0 +1,140 @@
+/*
+ * arena.c - Request-scoped arenas on top of the mm.c heap
+ *
+ * Chunks come from malloc; each starts with a small header linking it
+ * to the next chunk.  Allocation bumps a pointer through the newest
+ * chunk; when it is full a new chunk twice the size of the last one
+ * (up to ARENA_CHUNK_MAX) is added to the end of the chain.  Requests
+ * that don't fit in ARENA_CHUNK_MAX get a chunk of their own, on a
+ * separate list.  A reset keeps the first chunk and gives all others
+ * back to the heap, so an arena doesn't hold on to the memory of its
+ * largest request; with doubling chunk sizes there are few of them.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mm.h"
+#include "arena.h"
+
+#ifdef DRIVER
+#define malloc mm_malloc
+#define free mm_free
+#endif
+
+#define ARENA_ALIGN 16
+#define ARENA_CHUNK (1<<12)       /* first chunk, in bytes */
+#define ARENA_CHUNK_MAX (1<<20)   /* chunks stop growing here */
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;     /* next chunk of the chain */
+    size_t size;                  /* bytes of the chunk, header included */
+} __attribute__((aligned(ARENA_ALIGN))) arena_chunk_t;
+
+struct mm_arena {
+    arena_chunk_t *first;         /* first chunk of the chain, NULL if none */
+    arena_chunk_t *chunk;         /* newest chunk, NULL if none */
+    char *cur;                    /* next free byte of the newest chunk */
+    char *end;                    /* end of the newest chunk */
+    arena_chunk_t *big;           /* chunks of single large requests */
+};
+
+static size_t arena_align(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+}
+
+static void arena_use(mm_arena_t *arena, arena_chunk_t *chunk) {
+    arena->chunk = chunk;
+    arena->cur = (char *) (chunk + 1);
+    arena->end = (char *) chunk + chunk->size;
+}
+
+/* Start a new chunk large enough for size bytes at the end of the chain */
+static bool arena_grow(mm_arena_t *arena, size_t size) {
+    size_t chunk_size = arena->chunk ? 2 * arena->chunk->size : ARENA_CHUNK;
+    arena_chunk_t *chunk;
+
+    if (chunk_size > ARENA_CHUNK_MAX)
+        chunk_size = ARENA_CHUNK_MAX;
+    if (chunk_size < sizeof(arena_chunk_t) + size)
+        chunk_size = sizeof(arena_chunk_t) + size;
+    if ((chunk = malloc(chunk_size)) == NULL)
+        return false;
+
+    chunk->next = NULL;
+    chunk->size = chunk_size;
+    if (arena->chunk != NULL)
+        arena->chunk->next = chunk;
+    else
+        arena->first = chunk;
+    arena_use(arena, chunk);
+    return true;
+}
+
+/* A chunk for one request too large for the chain */
+static void *arena_alloc_big(mm_arena_t *arena, size_t size) {
+    arena_chunk_t *chunk = malloc(sizeof(arena_chunk_t) + size);
+
+    if (chunk == NULL)
+        return NULL;
+    chunk->next = arena->big;
+    chunk->size = sizeof(arena_chunk_t) + size;
+    arena->big = chunk;
+    return chunk + 1;
+}
+
+static void arena_free_chunks(arena_chunk_t *chunk) {
+    arena_chunk_t *next;
+
+    for (; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+}
+
+mm_arena_t *mm_arena_create(void) {
+    mm_arena_t *arena = malloc(sizeof(mm_arena_t));
+    if (arena != NULL) {
+        arena->first = NULL;
+        arena->chunk = NULL;
+        arena->cur = NULL;
+        arena->end = NULL;
+        arena->big = NULL;
+    }
+    return arena;
+}
+
+void *mm_arena_alloc(mm_arena_t *arena, size_t size) {
+    char *ptr;
+
+    if (size == 0 || size > SIZE_MAX / 2)
+        return NULL;
+    size = arena_align(size);
+    if ((size_t) (arena->end - arena->cur) < size) {
+        if (size > ARENA_CHUNK_MAX - sizeof(arena_chunk_t))
+            return arena_alloc_big(arena, size);
+        if (!arena_grow(arena, size))
+            return NULL;
+    }
+    ptr = arena->cur;
+    arena->cur += size;
+    return ptr;
+}
+
+void mm_arena_reset(mm_arena_t *arena) {
+    arena_free_chunks(arena->big);
+    arena->big = NULL;
+    if (arena->first != NULL) {
+        arena_free_chunks(arena->first->next);
+        arena->first->next = NULL;
+        arena_use(arena, arena->first);
+    }
+}
+
+void mm_arena_destroy(mm_arena_t *arena) {
+    if (arena == NULL)
+        return;
+    arena_free_chunks(arena->first);
+    arena_free_chunks(arena->big);
+    free(arena);
+}
@@ -0,0 +1,25 @@
+/*
+ * arena.h - Request-scoped arenas on top of the mm.c heap
+ *
+ * An arena bump-allocates from chunks it takes from the heap with
+ * malloc and frees all its objects at once: mm_arena_reset() costs
+ * O(chunks), not O(objects), and chunks double in size, so there are
+ * few.  Blocks from malloc() and from arenas can be mixed freely.
+ */
+#include <stddef.h>
+
+typedef struct mm_arena mm_arena_t;
+
+/* Create an empty arena; returns NULL if out of memory */
+mm_arena_t *mm_arena_create(void);
+
+/* Allocate size bytes (16-byte aligned) that live until the next reset;
+   returns NULL for size 0 or if out of memory */
+void *mm_arena_alloc(mm_arena_t *arena, size_t size);
+
+/* Free all objects of the arena; its first chunk is kept for reuse,
+   the others go back to the heap */
+void mm_arena_reset(mm_arena_t *arena);
+
+/* Free all objects and the arena itself */
+void mm_arena_destroy(mm_arena_t *arena);
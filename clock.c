@@ -19,6 +19,9 @@
 #else
 #include <time.h>
 #endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 #include "clock.h"
 
 int gverbose = 1;
@@ -141,3 +144,65 @@ double get_counter()
     return delta_secs * cpu_mhz * 1e6;
 }
 
+/* Time stamps for single operations.  A clock_gettime() call costs
+   more than many of the operations being timed, so on x86 this reads
+   the time stamp counter, which ticks at a constant rate on current
+   processors (not at the core clock, see the note at the top).
+   rdtscp waits for the instructions before it to finish and the
+   lfence keeps the ones after it from starting early, so the
+   operation being timed can't leak out of the interval. */
+unsigned long long read_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int aux;
+    unsigned long long t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+/* Calibrate the ticks against CLOCK_MONOTONIC over about 20 ms */
+double ticks_per_ns()
+{
+    static double rate = 0.0;
+    struct timespec t0, t1;
+    unsigned long long c0, c1;
+    double ns;
+
+    if (rate > 0.0)
+	return rate;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    c0 = read_ticks();
+    do {
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ns = 1e9 * (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec);
+    } while (ns < 2e7);
+    c1 = read_ticks();
+    rate = (c1 - c0) / ns;
+    if (rate <= 0.0)
+	rate = 1.0;
+    return rate;
+}
+
+unsigned long long ticks_overhead()
+{
+    static int done = 0;
+    static unsigned long long overhead;
+    int i;
+
+    if (done)
+	return overhead;
+    overhead = ~0ull;
+    for (i = 0; i < 1000; i++) {
+	unsigned long long t0 = read_ticks();
+	unsigned long long t1 = read_ticks();
+	if (t1 - t0 < overhead)
+	    overhead = t1 - t0;
+    }
+    done = 1;
+    return overhead;
+}
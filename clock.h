@@ -20,3 +20,13 @@ void start_counter();
 
 /* Get # cycles since counter started.  Returns 1e20 if detect timing anomaly */
 double get_counter();
+
+/* Ticks: cheap raw time stamps for timing single operations
+   (the time stamp counter on x86, else nanoseconds) */
+unsigned long long read_ticks();
+
+/* Ticks per nanosecond, calibrated against the wall clock on first use */
+double ticks_per_ns();
+
+/* Smallest difference of two back-to-back read_ticks() calls */
+unsigned long long ticks_overhead();
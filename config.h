@@ -104,6 +104,12 @@
 #define MAX_HEAP_SIZE (1ull*(1ull<<40)) /* 1 TB */
 
 
+/*
+ * mem_memcpy/mem_memset use non-temporal (cache-bypassing) stores for
+ * blocks of at least this many bytes
+ */
+#define MEM_NT_BYTES (1ul<<22) /* 4 MB */
+
 /***************** Parameters for looking up reference throughput *********/
 /*
  * Location of information on CPU type 
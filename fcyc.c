@@ -1,5 +1,10 @@
 /* Compute time used by function f */
+#define _GNU_SOURCE                     /* sched_getcpu, CPU_SET */
 #include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <sys/times.h>
 #include <stdio.h>
 
@@ -10,22 +15,44 @@
 #define MAXSAMPLES 20
 #define EPSILON 0.01 
 #define CLEAR_CACHE 0
-#define CACHE_BYTES (1<<19)
-#define CACHE_BLOCK 32
+#define CACHE_BYTES (1<<19)     /* if the LLC size can't be found */
+#define CACHE_BLOCK 64          /* if the line size can't be found */
+#define CACHE_SYSFS "/sys/devices/system/cpu/cpu0/cache"
 #define MIN_TICKS 1000
 #define MIN_REPS 8
+#define WARMUPS 2
+#define BOOTSTRAP 1000
+#define CONFIDENCE 0.95
 
 static long int kbest = K;
 static int clear_cache = CLEAR_CACHE;
 static long int maxsamples = MAXSAMPLES;
 static double epsilon = EPSILON;
-static long int cache_bytes = CACHE_BYTES;
-static long int cache_block = CACHE_BLOCK;
+static long int cache_bytes = 0;        /* 0: the LLC size */
+static long int cache_block = 0;        /* 0: the line size */
+static fcyc_cache_mode_t cache_mode = FCYC_CACHE_ANY;
 static long int min_reps = MIN_REPS;
 static long int min_ticks = MIN_TICKS;
 static double min_time = 0;
 
+/* Robust mode, off while robust_samples is 0 */
+static long int robust_samples = 0;
+static long int warmups = WARMUPS;
+static int pin_cpu = -1;
+static long int bootstrap = BOOTSTRAP;
+static double confidence = CONFIDENCE;
+static fcyc_stats_t last_stats;
+
 static long int *cache_buf = NULL;
+static long int cache_buf_bytes = 0;
+
+static fcyc_cache_t geometry;
+static int geometry_read = 0;
+
+/* LLC thrashing thread of FCYC_CACHE_THRASH */
+static pthread_t thrasher;
+static volatile int thrash_stop;
+static long int *thrash_buf = NULL;
 
 static double *values = NULL;
 static long int samplecount = 0;
@@ -90,42 +117,318 @@ static long int has_converged()
 	((1 + epsilon)*values[0] >= values[kbest-1]);
 }
 
+/* Cache geometry */
+
+/* Read attribute name of cache index i in sysfs into buf */
+static int read_cache_attr(int i, const char *name, char *buf, int len)
+{
+    char path[128];
+    FILE *f;
+    int ok;
+
+    snprintf(path, sizeof(path), CACHE_SYSFS "/index%d/%s", i, name);
+    if ((f = fopen(path, "r")) == NULL)
+	return 0;
+    ok = fgets(buf, len, f) != NULL;
+    fclose(f);
+    return ok;
+}
+
+/* Size like "48K" or "30M" in bytes */
+static long int parse_size(const char *s)
+{
+    char *end;
+    long int v = strtol(s, &end, 10);
+
+    if (*end == 'K')
+	v <<= 10;
+    else if (*end == 'M')
+	v <<= 20;
+    else if (*end == 'G')
+	v <<= 30;
+    return v;
+}
+
+const fcyc_cache_t *fcyc_cache_geometry(void)
+{
+    char buf[64];
+    int i, level, llc_level = 0;
+    long int size;
+
+    if (geometry_read)
+	return &geometry;
+    geometry_read = 1;
+
+    for (i = 0; read_cache_attr(i, "level", buf, sizeof(buf)); i++) {
+	level = atoi(buf);
+	if (!read_cache_attr(i, "type", buf, sizeof(buf)) ||
+	    strncmp(buf, "Instruction", 11) == 0 ||
+	    !read_cache_attr(i, "size", buf, sizeof(buf)))
+	    continue;
+	size = parse_size(buf);
+	if (level == 1)
+	    geometry.l1d = size;
+	else if (level == 2)
+	    geometry.l2 = size;
+	if (level > llc_level) {
+	    llc_level = level;
+	    geometry.llc = size;
+	}
+	if (read_cache_attr(i, "coherency_line_size", buf, sizeof(buf)) &&
+	    atol(buf) > geometry.line)
+	    geometry.line = atol(buf);
+    }
+
+    /* No sysfs (or not Linux): ask the C library, then guess */
+    if (geometry.l1d <= 0)
+	geometry.l1d = sysconf(_SC_LEVEL1_DCACHE_SIZE) > 0 ? sysconf(_SC_LEVEL1_DCACHE_SIZE) : 0;
+    if (geometry.l2 <= 0)
+	geometry.l2 = sysconf(_SC_LEVEL2_CACHE_SIZE) > 0 ? sysconf(_SC_LEVEL2_CACHE_SIZE) : 0;
+    if (geometry.llc <= 0)
+	geometry.llc = sysconf(_SC_LEVEL3_CACHE_SIZE) > 0 ? sysconf(_SC_LEVEL3_CACHE_SIZE)
+	    : geometry.l2 > 0 ? geometry.l2 : CACHE_BYTES;
+    if (geometry.line <= 0)
+	geometry.line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE) > 0
+	    ? sysconf(_SC_LEVEL1_DCACHE_LINESIZE) : CACHE_BLOCK;
+    return &geometry;
+}
+
 /* Code to clear cache */
 
 
 static volatile long int sink = 0;
 
-static void clear()
+/* Buffer of at least bytes for sweeping through */
+static long int *sweep_buf(long int bytes)
 {
-    long int x = sink;
-    long int *cptr, *cend;
-    long int incr = cache_block/sizeof(long int);
-    if (!cache_buf) {
-	cache_buf = malloc(cache_bytes);
+    if (bytes > cache_buf_bytes) {
+	free(cache_buf);
+	cache_buf = malloc(bytes);
 	if (!cache_buf) {
 	    fprintf(stderr, "Fatal error.  Malloc returned null when trying to clear cache\n");
 	    exit(1);
 	}
+	cache_buf_bytes = bytes;
     }
-    cptr = (long int *) cache_buf;
-    cend = cptr + cache_bytes/sizeof(long int);
+    return cache_buf;
+}
+
+/* Touch every block of bytes of buf; writing leaves the lines dirty,
+   so that evicting them costs a write-back, as real data would */
+static void sweep(long int *buf, long int bytes, long int block, int write)
+{
+    long int x = sink;
+    long int *cptr = buf, *cend = buf + bytes/sizeof(long int);
+    long int incr = block/sizeof(long int);
+
     while (cptr < cend) {
-	x += *cptr;
+	if (write)
+	    *cptr = x;
+	else
+	    x += *cptr;
 	cptr += incr;
     }
     sink = x;
 }
 
-double fcyc(test_funct f, void *args)
+static void clear()
+{
+    long int bytes = cache_bytes ? cache_bytes : fcyc_cache_geometry()->llc;
+    long int block = cache_block ? cache_block : fcyc_cache_geometry()->line;
+
+    sweep(sweep_buf(bytes), bytes, block, 0);
+}
+
+/* Put the caches into the state of cache_mode before a sample */
+static void prepare(test_funct f, void *args)
+{
+    long int bytes;
+
+    switch (cache_mode) {
+    case FCYC_CACHE_COLD:
+	/* Twice the LLC, as its replacement isn't exactly LRU */
+	bytes = 2 * fcyc_cache_geometry()->llc;
+	sweep(sweep_buf(bytes), bytes, fcyc_cache_geometry()->line, 1);
+	break;
+    case FCYC_CACHE_WARM:
+	f(args);
+	break;
+    default:
+	if (clear_cache)
+	    clear();
+	break;
+    }
+}
+
+/* Stream through an LLC-sized buffer until told to stop */
+static void *thrash_loop(void *arg)
+{
+    long int bytes = fcyc_cache_geometry()->llc;
+
+    while (!thrash_stop)
+	sweep(thrash_buf, bytes, fcyc_cache_geometry()->line, 1);
+    return NULL;
+}
+
+/* Start the thrashing thread, on another CPU than the caller if there is one */
+static void start_thrash()
+{
+    cpu_set_t mask, other;
+    int cpu = sched_getcpu(), i;
+
+    if (!thrash_buf && !(thrash_buf = malloc(fcyc_cache_geometry()->llc))) {
+	fprintf(stderr, "Fatal error.  Malloc returned null when trying to thrash cache\n");
+	exit(1);
+    }
+    thrash_stop = 0;
+    if (pthread_create(&thrasher, NULL, thrash_loop, NULL) != 0) {
+	fprintf(stderr, "Fatal error.  Could not start the cache thrashing thread\n");
+	exit(1);
+    }
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+	for (i = 0; i < CPU_SETSIZE; i++) {
+	    if (i != cpu && CPU_ISSET(i, &mask)) {
+		CPU_ZERO(&other);
+		CPU_SET(i, &other);
+		pthread_setaffinity_np(thrasher, sizeof(other), &other);
+		break;
+	    }
+	}
+    }
+}
+
+static void stop_thrash()
+{
+    thrash_stop = 1;
+    pthread_join(thrasher, NULL);
+}
+
+/* Robust mode */
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* Median of the n values of x, which this sorts */
+static double median(double *x, long n)
+{
+    qsort(x, n, sizeof(double), cmp_double);
+    return (n % 2) ? x[n/2] : (x[n/2 - 1] + x[n/2]) / 2;
+}
+
+/* Pin the calling thread to one CPU, saving its affinity in old */
+static int pin_thread(cpu_set_t *old)
+{
+    static int warned = 0;
+    cpu_set_t one;
+    int cpu = (pin_cpu >= 0) ? pin_cpu : sched_getcpu();
+
+    if (cpu < 0 || sched_getaffinity(0, sizeof(*old), old) != 0)
+	return 0;
+    CPU_ZERO(&one);
+    CPU_SET(cpu, &one);
+    if (sched_setaffinity(0, sizeof(one), &one) != 0) {
+	if (!warned)
+	    fprintf(stderr, "fcyc: could not pin to CPU %d, timing unpinned\n", cpu);
+	warned = 1;
+	return 0;
+    }
+    return 1;
+}
+
+/* Median, MAD and bootstrap confidence interval of the median of x */
+static void summarize(const double *x, long n, fcyc_stats_t *st)
+{
+    double *s = malloc(n * sizeof(double));
+    double *meds = malloc(bootstrap * sizeof(double));
+    unsigned long long rnd = 88172645463325252ull;   /* xorshift64 state */
+    long i, b, lo, hi;
+
+    if (!s || !meds) {
+	fprintf(stderr, "Fatal error.  Malloc returned null in fcyc summarize\n");
+	exit(1);
+    }
+    st->samples = n;
+    memcpy(s, x, n * sizeof(double));
+    st->median = median(s, n);
+    for (i = 0; i < n; i++)
+	s[i] = (x[i] > st->median) ? x[i] - st->median : st->median - x[i];
+    st->mad = median(s, n);
+
+    /* Medians of resamples drawn with replacement */
+    for (b = 0; b < bootstrap; b++) {
+	for (i = 0; i < n; i++) {
+	    rnd ^= rnd << 13;
+	    rnd ^= rnd >> 7;
+	    rnd ^= rnd << 17;
+	    s[i] = x[rnd % n];
+	}
+	meds[b] = median(s, n);
+    }
+    qsort(meds, bootstrap, sizeof(double), cmp_double);
+    lo = (long) ((1.0 - confidence) / 2 * bootstrap);
+    hi = (long) ((1.0 + confidence) / 2 * bootstrap);
+    if (hi > bootstrap - 1)
+	hi = bootstrap - 1;
+    st->ci_lo = meds[lo];
+    st->ci_hi = meds[hi];
+    free(s);
+    free(meds);
+}
+
+/*
+ * Time reps calls of f robust_samples times, after warmups, pinned to
+ * one CPU; returns the median time (or cycles) of a call
+ */
+static double robust(test_funct f, void *args, long reps, int cycles)
+{
+    double *x = malloc(robust_samples * sizeof(double));
+    cpu_set_t old;
+    int pinned = pin_thread(&old);
+    long i, r;
+
+    if (!x) {
+	fprintf(stderr, "Fatal error.  Malloc returned null in fcyc robust\n");
+	exit(1);
+    }
+    for (i = 0; i < warmups; i++) {
+	for (r = 0; r < reps; r++)
+	    f(args);
+    }
+    for (i = 0; i < robust_samples; i++) {
+	prepare(f, args);
+	if (cycles) {
+	    start_counter();
+	    for (r = 0; r < reps; r++)
+		f(args);
+	    x[i] = (double) get_counter() / reps;
+	} else {
+	    start_timer();
+	    for (r = 0; r < reps; r++)
+		f(args);
+	    x[i] = get_timer() / reps;
+	}
+    }
+    if (pinned)
+	sched_setaffinity(0, sizeof(old), &old);
+    summarize(x, robust_samples, &last_stats);
+    free(x);
+    return last_stats.median;
+}
+
+/* A cold sample is a single call: the ones after it would be warm */
+static double measure_cycles(test_funct f, void *args)
 {
     double result;
-    long reps = min_reps;
+    long reps = (cache_mode == FCYC_CACHE_COLD) ? 1 : min_reps;
     long r;
     double cyc;
     /* Increase reps until get meaningful times */
     double sec = 0.0;
     init_min_time();
-    while (sec < min_time) {
+    while (cache_mode != FCYC_CACHE_COLD && sec < min_time) {
 	if (clear_cache)
 	    clear();
 	start_timer();
@@ -136,10 +439,11 @@ double fcyc(test_funct f, void *args)
 	if (sec < min_time)
 	    reps += reps;
     }
+    if (robust_samples > 0)
+	return robust(f, args, reps, 1);
     init_sampler();
     do {
-	if (clear_cache)
-	    clear();
+	prepare(f, args);
 	start_counter();
 	for (r = 0; r < reps; r++) {
 	    f(args);
@@ -156,15 +460,15 @@ double fcyc(test_funct f, void *args)
     return result;  
 }
 
-double fsec(test_funct f, void *args)
+static double measure_secs(test_funct f, void *args)
 {
     double result;
     /* Increase reps until get meaningful times */
-    long reps = min_reps;
+    long reps = (cache_mode == FCYC_CACHE_COLD) ? 1 : min_reps;
     long r;
     double sec = 0.0;
     init_min_time();
-    while (sec < min_time) {
+    while (cache_mode != FCYC_CACHE_COLD && sec < min_time) {
 	if (clear_cache)
 	    clear();
 	start_timer();
@@ -176,11 +480,12 @@ double fsec(test_funct f, void *args)
 	    reps += reps;
 	//	printf("uSecs = %.3f, reps = %ld\n", sec * 1e6, reps);
     }
+    if (robust_samples > 0)
+	return robust(f, args, reps, 0);
     init_sampler();
     //    printf("\nuSecs (reps=%ld):", reps);
     do {
-	if (clear_cache)
-	    clear();
+	prepare(f, args);
 	start_timer();
 	for (r = 0; r < reps; r++) {
 	    f(args);
@@ -199,6 +504,30 @@ double fsec(test_funct f, void *args)
     return result;  
 }
 
+double fcyc(test_funct f, void *args)
+{
+    double result;
+
+    if (cache_mode == FCYC_CACHE_THRASH)
+	start_thrash();
+    result = measure_cycles(f, args);
+    if (cache_mode == FCYC_CACHE_THRASH)
+	stop_thrash();
+    return result;
+}
+
+double fsec(test_funct f, void *args)
+{
+    double result;
+
+    if (cache_mode == FCYC_CACHE_THRASH)
+	start_thrash();
+    result = measure_secs(f, args);
+    if (cache_mode == FCYC_CACHE_THRASH)
+	stop_thrash();
+    return result;
+}
+
 
 /***********************************************************/
 /* Set the various parameters used by measurement routines */
@@ -223,21 +552,15 @@ void set_fcyc_clear_cache(int clear)
 }
 
 /* Set size of cache to use when clearing cache 
-   Default = 1<<19 (512KB)
+   Default = 0, the size of the LLC (fcyc_cache_geometry)
 */
 void set_fcyc_cache_size(long int bytes)
 {
-    if (bytes != cache_bytes) {
-	cache_bytes = bytes;
-	if (cache_buf) {
-	    free(cache_buf);
-	    cache_buf = NULL;
-	}
-    }
+    cache_bytes = bytes;
 }
 
 /* Set size of cache block 
-   Default = 32
+   Default = 0, the line size (fcyc_cache_geometry)
 */
 void set_fcyc_cache_block(long int bytes) {
     cache_block = bytes;
@@ -268,6 +591,53 @@ void set_fcyc_epsilon(double epsilon_arg)
     epsilon = epsilon_arg;
 }
 
+/* Robust mode with n samples per measurement, 0 for K-best
+   Default = 0
+*/
+void set_fcyc_robust(long int n)
+{
+    robust_samples = n;
+}
+
+/* Untimed runs before the samples of robust mode
+   Default = 2
+*/
+void set_fcyc_warmups(long int w)
+{
+    warmups = w;
+}
+
+/* CPU to pin to in robust mode, -1 for the one it runs on
+   Default = -1
+*/
+void set_fcyc_cpu(int cpu)
+{
+    pin_cpu = cpu;
+}
+
+/* Resamples and confidence level of the bootstrap interval
+   Default = 1000, 0.95
+*/
+void set_fcyc_bootstrap(long int resamples, double confidence_arg)
+{
+    bootstrap = resamples;
+    confidence = confidence_arg;
+}
+
+/* State of the caches at the start of each sample
+   Default = FCYC_CACHE_ANY
+*/
+void set_fcyc_cache_mode(fcyc_cache_mode_t mode)
+{
+    cache_mode = mode;
+}
+
+/* Statistics of the last measurement in robust mode */
+void fcyc_last_stats(fcyc_stats_t *stats)
+{
+    *stats = last_stats;
+}
+
 
 
 
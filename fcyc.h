@@ -7,6 +7,31 @@
 
 typedef void (*test_funct)(void *);
 
+/* Cache geometry: sizes in bytes, 0 for a level that isn't there */
+typedef struct {
+    long int line;              /* cache line */
+    long int l1d, l2, llc;      /* L1 data, L2 and last-level cache */
+} fcyc_cache_t;
+
+/* State of the caches at the start of each sample */
+typedef enum {
+    FCYC_CACHE_ANY,             /* as left by the previous sample (or cleared,
+                                   see set_fcyc_clear_cache) */
+    FCYC_CACHE_COLD,            /* nothing cached: twice the LLC is swept
+                                   first, and each sample is a single call */
+    FCYC_CACHE_WARM,            /* f's data cached by an untimed call first */
+    FCYC_CACHE_THRASH           /* a thread on another CPU streams through
+                                   an LLC-sized buffer while f runs */
+} fcyc_cache_mode_t;
+
+/* Summary of the samples of a measurement in robust mode */
+typedef struct {
+    long int samples;
+    double median;              /* the result */
+    double mad;                 /* median absolute deviation */
+    double ci_lo, ci_hi;        /* bootstrap confidence interval of the median */
+} fcyc_stats_t;
+
 /* Compute number of cycles used by function f on given set of parameters */
 double fcyc(test_funct f, void* args);
 
@@ -29,12 +54,12 @@ void set_fcyc_min_reps(int r);
 void set_fcyc_clear_cache(int clear);
 
 /* Set size of cache to use when clearing cache 
-   Default = 1<<19 (512KB)
+   Default = 0, the size of the LLC (fcyc_cache_geometry)
 */
 void set_fcyc_cache_size(long int bytes);
 
 /* Set size of cache block 
-   Default = 32
+   Default = 0, the line size (fcyc_cache_geometry)
 */
 void set_fcyc_cache_block(long int bytes);
 
@@ -59,5 +84,35 @@ void set_fcyc_maxsamples(long int maxsamples);
 */
 void set_fcyc_epsilon(double epsilon);
 
+/* Robust mode: when n > 0, fcyc and fsec do warmup runs, pin the
+   thread to one CPU and return the median of n samples instead of
+   the K-best minimum.  Default = 0 (K-best)
+*/
+void set_fcyc_robust(long int n);
+
+/* Untimed runs before the samples of robust mode
+   Default = 2
+*/
+void set_fcyc_warmups(long int w);
+
+/* CPU to pin to in robust mode, -1 for the one it runs on
+   Default = -1
+*/
+void set_fcyc_cpu(int cpu);
+
+/* Resamples and confidence level of the bootstrap interval
+   Default = 1000, 0.95
+*/
+void set_fcyc_bootstrap(long int resamples, double confidence);
 
+/* Median, MAD and confidence interval of the last robust measurement */
+void fcyc_last_stats(fcyc_stats_t *stats);
 
+/* Cache geometry of CPU 0, from /sys/devices/system/cpu/cpu0/cache, or
+   sysconf() where that is missing */
+const fcyc_cache_t *fcyc_cache_geometry(void);
+
+/* State of the caches at the start of each sample
+   Default = FCYC_CACHE_ANY
+*/
+void set_fcyc_cache_mode(fcyc_cache_mode_t mode);
@@ -0,0 +1,78 @@
+/*
+ * Log-bucketed histograms for latency measurements, see hist.h
+ */
+
+#include <string.h>
+#include <math.h>
+#include "hist.h"
+
+/* Bucket holding value v */
+static int bucket_index(unsigned long long v)
+{
+    int k;
+
+    if (v < HIST_SUB)
+	return (int) v;
+    k = 63 - __builtin_clzll(v);   /* position of the leading one */
+    return (k - HIST_SUB_BITS + 1) * HIST_SUB
+	+ (int) ((v >> (k - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/* Largest value that falls into bucket i */
+static unsigned long long bucket_high(int i)
+{
+    int k, sub;
+    unsigned long long lo;
+
+    if (i < HIST_SUB)
+	return i;
+    k = i / HIST_SUB + HIST_SUB_BITS - 1;
+    sub = i % HIST_SUB;
+    lo = (unsigned long long) (HIST_SUB + sub) << (k - HIST_SUB_BITS);
+    return lo + (1ull << (k - HIST_SUB_BITS)) - 1;
+}
+
+void hist_reset(hist_t *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+void hist_add(hist_t *h, unsigned long long v)
+{
+    h->bucket[bucket_index(v)]++;
+    h->count++;
+    if (v > h->max)
+	h->max = v;
+}
+
+void hist_merge(hist_t *dst, const hist_t *src)
+{
+    int i;
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+	dst->bucket[i] += src->bucket[i];
+    dst->count += src->count;
+    if (src->max > dst->max)
+	dst->max = src->max;
+}
+
+unsigned long long hist_percentile(const hist_t *h, double pct)
+{
+    unsigned long long rank, seen = 0;
+    unsigned long long high;
+    int i;
+
+    if (h->count == 0)
+	return 0;
+    rank = (unsigned long long) ceil(pct / 100.0 * h->count);
+    if (rank < 1)
+	rank = 1;
+    for (i = 0; i < HIST_BUCKETS; i++) {
+	seen += h->bucket[i];
+	if (seen >= rank) {
+	    high = bucket_high(i);
+	    return high < h->max ? high : h->max;
+	}
+    }
+    return h->max;
+}
@@ -0,0 +1,39 @@
+/*
+ * Log-bucketed histograms for latency measurements
+ *
+ * Values below HIST_SUB are counted exactly.  Above that, each power
+ * of two is split into HIST_SUB equal sub-buckets, so a bucket is
+ * never wider than 1/HIST_SUB of the values it holds (about 6% with
+ * HIST_SUB = 16), in the style of HdrHistogram.  The maximum is
+ * tracked exactly.
+ */
+#ifndef HIST_H_
+#define HIST_H_
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB      (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS  ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long max;
+    unsigned long long bucket[HIST_BUCKETS];
+} hist_t;
+
+/* Clear all counts */
+void hist_reset(hist_t *h);
+
+/* Record one value */
+void hist_add(hist_t *h, unsigned long long v);
+
+/* Add the counts of src into dst */
+void hist_merge(hist_t *dst, const hist_t *src);
+
+/*
+ * Value at the given percentile (0 < pct <= 100), reported as the
+ * upper bound of its bucket but never above the maximum.  Returns 0
+ * for an empty histogram.
+ */
+unsigned long long hist_percentile(const hist_t *h, double pct);
+
+#endif /* HIST_H_ */
@@ -0,0 +1,94 @@
+/*
+ * idmap.c - Hash map from 64-bit keys to a value and a size (idmap.h)
+ */
+#include <stdlib.h>
+
+#include "idmap.h"
+
+bool idmap_init(idmap_t *map, int bits)
+{
+    size_t i, n = (size_t) 1 << bits;
+
+    if ((map->slots = malloc(n * sizeof(idmap_slot_t))) == NULL)
+        return false;
+    for (i = 0; i < n; i++)
+        map->slots[i].key = IDMAP_EMPTY;
+    map->bits = bits;
+    map->count = 0;
+    return true;
+}
+
+void idmap_destroy(idmap_t *map)
+{
+    free(map->slots);
+    map->slots = NULL;
+    map->count = 0;
+}
+
+/* Fibonacci hashing: the top bits of the key times 2^64 / phi */
+static inline size_t idmap_hash(const idmap_t *map, uint64_t key)
+{
+    return (key * 0x9e3779b97f4a7c15ull) >> (64 - map->bits);
+}
+
+idmap_slot_t *idmap_find(idmap_t *map, uint64_t key)
+{
+    size_t mask = ((size_t) 1 << map->bits) - 1;
+    size_t i = idmap_hash(map, key);
+
+    while (map->slots[i].key != key && map->slots[i].key != IDMAP_EMPTY)
+        i = (i + 1) & mask;
+    return &map->slots[i];
+}
+
+bool idmap_put(idmap_t *map, uint64_t key, uint64_t val, size_t size)
+{
+    idmap_slot_t *slot = idmap_find(map, key);
+
+    if (slot->key == IDMAP_EMPTY) {
+        if (2 * (map->count + 1) > ((size_t) 1 << map->bits)) {
+            idmap_t bigger;
+            size_t i, n = (size_t) 1 << map->bits;
+
+            if (!idmap_init(&bigger, map->bits + 1))
+                return false;
+            for (i = 0; i < n; i++)
+                if (map->slots[i].key != IDMAP_EMPTY)
+                    *idmap_find(&bigger, map->slots[i].key) = map->slots[i];
+            bigger.count = map->count;
+            free(map->slots);
+            *map = bigger;
+            slot = idmap_find(map, key);
+        }
+        map->count++;
+    }
+    slot->key = key;
+    slot->val = val;
+    slot->size = size;
+    return true;
+}
+
+/*
+ * Empty the slot, then move back the entries of the same probe run
+ * that could no longer be found
+ */
+void idmap_remove(idmap_t *map, idmap_slot_t *slot)
+{
+    size_t mask = ((size_t) 1 << map->bits) - 1;
+    size_t hole = slot - map->slots;
+    size_t i = hole;
+
+    for (;;) {
+        i = (i + 1) & mask;
+        if (map->slots[i].key == IDMAP_EMPTY)
+            break;
+        size_t home = idmap_hash(map, map->slots[i].key);
+        /* Move i into the hole unless its home lies in (hole, i] */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            map->slots[hole] = map->slots[i];
+            hole = i;
+        }
+    }
+    map->slots[hole].key = IDMAP_EMPTY;
+    map->count--;
+}
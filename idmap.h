@@ -0,0 +1,50 @@
+/*
+ * Hash map from 64-bit keys to a value and a size, for the live
+ * blocks of a trace: by id in mdriver's streaming replay, by address
+ * in the recorder
+ *
+ * Open addressing with linear probing, kept at most half full.
+ * Removal shifts the following entries back, so there are no
+ * tombstones.  The key IDMAP_EMPTY (-1) marks an empty slot and can't
+ * be stored.
+ */
+#ifndef IDMAP_H_
+#define IDMAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IDMAP_EMPTY UINT64_MAX
+
+typedef struct {
+    uint64_t key;                /* IDMAP_EMPTY for an empty slot */
+    uint64_t val;
+    size_t size;
+} idmap_slot_t;
+
+typedef struct {
+    idmap_slot_t *slots;
+    int bits;                    /* the table has 1 << bits slots */
+    size_t count;
+} idmap_t;
+
+/* An empty map of 1 << bits slots; false if out of memory */
+bool idmap_init(idmap_t *map, int bits);
+
+/* Free the slots of a map */
+void idmap_destroy(idmap_t *map);
+
+/* The slot of key, or the empty slot where it belongs */
+idmap_slot_t *idmap_find(idmap_t *map, uint64_t key);
+
+/*
+ * Store val and size for key, which may already be in the map.
+ * Returns false if the map had to grow and was out of memory.
+ */
+bool idmap_put(idmap_t *map, uint64_t key, uint64_t val, size_t size);
+
+/* Remove a slot that idmap_find() returned for a key in the map */
+void idmap_remove(idmap_t *map, idmap_slot_t *slot);
+
+#endif /* IDMAP_H_ */
@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <float.h>
+#include <limits.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdarg.h>
@@ -20,12 +21,21 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "mm.h"
 #include "memlib.h"
 #include "fcyc.h"
 #include "config.h"
 #include "stree.h"
+#include "clock.h"
+#include "hist.h"
+#include "mrep.h"
+#include "ttest.h"
+#include "idmap.h"
 
 /**********************
  * Constants and macros
@@ -43,6 +53,14 @@
 /* Returns true if p is ALIGNMENT-byte aligned */
 #define IS_ALIGNED(p)  ((((unsigned long)(p)) % ALIGNMENT) == 0)
 
+/* Results files (-o) and comparison with a baseline (-b) */
+#define RESULT_SAMPLES      5     /* timings per trace unless set by -r */
+#define RESULT_SAMPLES_MAX 64
+#define RESULT_ALPHA     0.01     /* significance level of the t-test */
+#define RESULT_MIN_CHANGE 0.05    /* smaller throughput changes are noise */
+#define RESULT_UTIL_DROP 0.001    /* smaller utilization drops are noise */
+#define EXIT_REGRESSION     2     /* exit status if -b found a regression */
+
 /* weights */
 typedef enum { WNONE, WALL, WUTIL, WPERF } weight_t;
 
@@ -83,6 +101,7 @@ typedef struct {
     enum { ALLOC, FREE, REALLOC } type; /* type of request */
     long index;                         /* index for free() to use later */
     size_t size;                        /* byte size of alloc/realloc request */
+    int hint;                           /* ALLOC: mm_malloc_hint flags, 0 for none */
 } traceop_t;
 
 /* Holds the information for one trace file */
@@ -121,10 +140,60 @@ typedef struct {
 
     /* defined only for the student malloc package */
     double util;       /* space utilization for this trace (always 0 for libc) */
+    size_t heap;       /* heap high-water mark in bytes */
+    int num_samples;   /* throughput of repeated timings, for -o and -b */
+    double kops[RESULT_SAMPLES_MAX];
+    fcyc_stats_t robust; /* spread of the first timing, with -R */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t;
 
+/* Latency histograms for one trace, indexed by traceop_t type */
+typedef struct {
+    hist_t op[3];
+} latency_t;
+
+/*
+ * One replay thread of the multithreaded mode (-m).  Each thread has
+ * its own copy of its trace, so the block ids of the threads are
+ * disjoint.
+ */
+typedef struct mt_thread {
+    trace_t *trace;
+    int id;
+    int nthreads;
+    struct mt_thread *peer;      /* receives this thread's remote frees */
+    pthread_barrier_t *start;
+    pthread_barrier_t *done;     /* passed once no thread hands over blocks */
+    void *remote;                /* blocks handed over by other threads, linked
+                                    through their first payload word */
+    long ops;                    /* requests this thread carried out */
+    double start_time;           /* wall clock times of the replay */
+    double end_time;
+} mt_thread_t;
+
+/*
+ * Streaming replay (-S): a reader thread decodes the trace into two
+ * buffers of STREAM_CHUNK requests, which the replay thread takes in
+ * turn, so no more than two chunks are ever in memory.  A buffer is
+ * full once the reader has published it and empty again once the
+ * replay is done with it; a buffer of fewer than STREAM_CHUNK
+ * requests is the last one.
+ */
+#define STREAM_CHUNK (1 << 16)
+#define STREAM_READ  (1 << 20)   /* bytes per read of a binary trace */
+
+typedef struct {
+    FILE *file;
+    bool binary;
+    long num_ops;                /* requests announced by the header */
+    traceop_t *ops[2];
+    int count[2];
+    bool full[2];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} stream_t;
+
 /* Summarizes the key statistics for a set of traces */
 typedef struct {
     double util;  /* average utilization expressed as a percentage */
@@ -165,6 +234,49 @@ static size_t maxfill = MAXFILL;
 /* by default, no timeouts */
 static int set_timeout = 0;
 
+/* Hint allocations freed within this many ops as short-lived (-H), 0 for none */
+static long hint_dist = 0;
+
+/* Run every placement policy of policy_specs instead of grading (-P) */
+static bool policy_sweep = false;
+
+/* Time every operation and report latency percentiles (set by -L) */
+static bool latency_mode = false;
+static latency_t *latency_stats = NULL;
+
+/* Replay on 1..mt_threads threads at once (set by -m), handing the
+   fraction mt_remote of the frees to another thread (set by -x) */
+static int mt_threads = 0;
+static double mt_remote = 0.0;
+
+/* Trace to replay in streaming mode (set by -S) */
+static char *stream_file = NULL;
+
+/* Write results to this .json or .csv file (set by -o), compare them
+   with those of a baseline file (set by -b), timing every trace
+   result_samples times (set by -r) */
+static char *results_file = NULL;
+static char *baseline_file = NULL;
+static int result_samples = 0;
+
+/* Time with fcyc's robust mode, with this many samples (set by -R) */
+static long robust_samples = 0;
+
+/* State of the caches when timing, see fcyc.h (set by -k) */
+static char *cache_modes[] = { "any", "cold", "warm", "thrash", NULL };
+static fcyc_cache_mode_t cache_mode = FCYC_CACHE_ANY;
+
+/* mm_config_parse settings compared by the policy sweep */
+static char *policy_specs[] = {
+    "order=lifo,fit=first,split=size", "order=lifo,fit=first,split=low", "order=lifo,fit=first,split=high",
+    "order=lifo,fit=next,split=size",  "order=lifo,fit=next,split=low",  "order=lifo,fit=next,split=high",
+    "order=lifo,fit=best,split=size",  "order=lifo,fit=best,split=low",  "order=lifo,fit=best,split=high",
+    "order=lifo,fit=good,split=size",  "order=lifo,fit=good,split=low",  "order=lifo,fit=good,split=high",
+    "order=address,fit=first,split=size", "order=address,fit=first,split=low", "order=address,fit=first,split=high",
+    "order=address,fit=next,split=size",  "order=address,fit=best,split=size",  "order=address,fit=good,split=size",
+    NULL
+};
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
@@ -209,6 +321,8 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
                            const char *filename);
 static void reinit_trace(trace_t *trace);
 static void free_trace(trace_t *trace);
+static void hint_trace(trace_t *trace);
+static inline void *hinted_malloc(size_t size, int hint);
 
 /* Routines for evaluating the correctness and speed of libc malloc */
 static bool eval_libc_valid(trace_t *trace);
@@ -217,11 +331,20 @@ static void eval_libc_speed(void *ptr);
 /* Routines for evaluating correctnes, space utilization, and speed
    of the student's malloc package in mm.c */
 static bool eval_mm_valid(trace_t *trace, range_set_t *ranges);
-static double eval_mm_util(trace_t *trace, int tracenum);
+static double eval_mm_util(trace_t *trace, int tracenum, size_t *heap);
 static void eval_mm_speed(void *ptr);
+static void eval_mm_latency(trace_t *trace, latency_t *lat);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats, sum_stats_t *sumstats);
+static void sumresults(int n, stats_t *stats, sum_stats_t *sumstats);
+static void printlatency(int n, stats_t *stats, latency_t *lat);
+static void printrobust(int n, stats_t *stats);
+static void write_results(const char *file, int n, stats_t *stats, latency_t *lat);
+static int compare_baseline(const char *file, int n, stats_t *stats);
+static void run_policy_sweep(speed_t *speed_params);
+static void run_mt_replay(void);
+static void run_stream_replay(void);
 static void usage(char *prog);
 static void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
     __attribute__((format(printf, 3,4)));
@@ -283,12 +406,22 @@ static void run_tests(int num_tracefiles, const char *tracedir,
         if (mm_stats[i].valid) {
             if (verbose > 1)
                 printf("efficiency, ");
-            mm_stats[i].util = eval_mm_util(trace, i);
+            mm_stats[i].util = eval_mm_util(trace, i, &mm_stats[i].heap);
             speed_params->trace = trace;
             speed_params->ranges = ranges;
             if (verbose > 1)
                 printf("and performance.\n");
             mm_stats[i].secs = fsec(eval_mm_speed, speed_params);
+            if (robust_samples > 0)
+                fcyc_last_stats(&mm_stats[i].robust);
+            mm_stats[i].kops[0] = mm_stats[i].ops * 1e-3 / mm_stats[i].secs;
+            mm_stats[i].num_samples = 1;
+            while (mm_stats[i].num_samples < result_samples) {
+                double secs = fsec(eval_mm_speed, speed_params);
+                mm_stats[i].kops[mm_stats[i].num_samples++] = mm_stats[i].ops * 1e-3 / secs;
+            }
+            if (latency_mode)
+                eval_mm_latency(trace, &latency_stats[i]);
         }
 
 #if 0
@@ -304,6 +437,562 @@ static void run_tests(int num_tracefiles, const char *tracedir,
     }
 }
 
+/*
+ * wall_time - seconds on the monotonic clock.  fsec() measures the
+ *    CPU time of the calling thread, which misses the other threads.
+ */
+static double wall_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * mt_push_remote - hand block p to thread t, which frees it later
+ */
+static void mt_push_remote(mt_thread_t *t, void *p)
+{
+    void *head = __atomic_load_n(&t->remote, __ATOMIC_RELAXED);
+    do {
+        *(void **)p = head;
+    } while (!__atomic_compare_exchange_n(&t->remote, &head, p, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ * mt_drain_remote - free the blocks handed to thread t so far;
+ *    returns how many there were
+ */
+static long mt_drain_remote(mt_thread_t *t)
+{
+    long n = 0;
+    void *p = __atomic_exchange_n(&t->remote, NULL, __ATOMIC_ACQUIRE);
+
+    while (p != NULL) {
+        void *next = *(void **)p;
+        mm_free(p);
+        p = next;
+        n++;
+    }
+    return n;
+}
+
+/*
+ * mt_replay - thread body of the multithreaded mode: like
+ *    eval_mm_speed, except that a pseudo-random mt_remote share of
+ *    the frees goes to the peer thread, and that the blocks handed
+ *    over by other threads are freed every 64 requests.  A thread
+ *    that is done waits for the others before its last drain and
+ *    stops its clock after it, so every free is counted once and
+ *    timed.
+ */
+static void *mt_replay(void *arg)
+{
+    mt_thread_t *t = arg;
+    trace_t *trace = t->trace;
+    unsigned int rnd = 2463534242u + t->id;   /* xorshift32 state */
+    unsigned int remote_limit = (unsigned int) (mt_remote * 4294967295.0);
+    bool remote = t->nthreads > 1 && mt_remote > 0;
+    int i, index;
+    char *p;
+
+    reinit_trace(trace);
+    t->ops = 0;
+    pthread_barrier_wait(t->start);
+    t->start_time = wall_time();
+
+    for (i = 0; i < trace->num_ops; i++) {
+        index = trace->ops[i].index;
+        switch (trace->ops[i].type) {
+
+            case ALLOC: /* mm_malloc */
+                if ((p = hinted_malloc(trace->ops[i].size, trace->ops[i].hint)) == NULL)
+                    app_error("mm_malloc error in mt_replay");
+                trace->blocks[index] = p;
+                break;
+
+            case REALLOC: /* mm_realloc */
+                p = mm_realloc(trace->blocks[index], trace->ops[i].size);
+                if (p == NULL && trace->ops[i].size != 0)
+                    app_error("mm_realloc error in mt_replay");
+                trace->blocks[index] = p;
+                break;
+
+            case FREE: /* mm_free, here or by the peer */
+                p = index < 0 ? NULL : trace->blocks[index];
+                if (remote && p != NULL) {
+                    rnd ^= rnd << 13;
+                    rnd ^= rnd >> 17;
+                    rnd ^= rnd << 5;
+                    if (rnd <= remote_limit) {
+                        mt_push_remote(t->peer, p);
+                        continue;
+                    }
+                }
+                mm_free(p);
+                break;
+
+            default:
+                app_error("Nonexistent request type in mt_replay");
+        }
+        t->ops++;
+        if ((i & 63) == 0)
+            t->ops += mt_drain_remote(t);
+    }
+    t->ops += mt_drain_remote(t);
+    pthread_barrier_wait(t->done);
+    t->ops += mt_drain_remote(t);
+    t->end_time = wall_time();
+    return NULL;
+}
+
+/*
+ * mt_run - replay the traces of the first n threads concurrently on
+ *    a fresh heap; returns the elapsed wall clock time
+ */
+static double mt_run(mt_thread_t *threads, int n)
+{
+    pthread_t *tids;
+    pthread_barrier_t start, done;
+    double first, last;
+    int i;
+
+    if ((tids = calloc(n, sizeof(pthread_t))) == NULL)
+        unix_error("tids calloc in mt_run failed");
+    pthread_barrier_init(&start, NULL, n);
+    pthread_barrier_init(&done, NULL, n);
+
+    mem_reset_brk();
+    if (!mm_init())
+        app_error("mm_init failed in mt_run");
+
+    for (i = 0; i < n; i++) {
+        threads[i].nthreads = n;
+        threads[i].peer = &threads[(i + 1) % n];
+        threads[i].start = &start;
+        threads[i].done = &done;
+        threads[i].remote = NULL;
+        if (pthread_create(&tids[i], NULL, mt_replay, &threads[i]) != 0)
+            unix_error("pthread_create in mt_run failed");
+    }
+    for (i = 0; i < n; i++)
+        pthread_join(tids[i], NULL);
+
+    first = threads[0].start_time;
+    last = threads[0].end_time;
+    for (i = 0; i < n; i++) {
+        if (threads[i].start_time < first)
+            first = threads[i].start_time;
+        if (threads[i].end_time > last)
+            last = threads[i].end_time;
+    }
+
+    pthread_barrier_destroy(&start);
+    pthread_barrier_destroy(&done);
+    free(tids);
+    return last - first;
+}
+
+/*
+ * run_mt_replay - replay traces on 1, 2, ... mt_threads threads
+ *    against one heap and print the scaling curve, then the per-thread
+ *    results at mt_threads threads.  Thread i replays trace i modulo
+ *    the number of traces, so a single -f trace runs as N copies.
+ *    Every point is the fastest of MT_REPS runs.  mm.c is made thread
+ *    safe with its lock setting; correctness is only checked by the
+ *    normal mode.
+ */
+#define MT_REPS 3
+
+static void run_mt_replay(void)
+{
+    mt_thread_t *threads, *best;
+    stats_t stats;
+    double base_kops = 0;
+    int n, i, rep;
+
+    if ((threads = calloc(mt_threads, sizeof(mt_thread_t))) == NULL ||
+        (best = calloc(mt_threads, sizeof(mt_thread_t))) == NULL)
+        unix_error("threads calloc in run_mt_replay failed");
+    for (i = 0; i < mt_threads; i++) {
+        threads[i].trace = read_trace(&stats, tracedir,
+                                      global_tracefiles[i % num_global_tracefiles]);
+        threads[i].id = i;
+    }
+
+    mm_config(MM_CFG_LOCK, 1);
+    mem_init();
+
+    printf("\nMultithreaded replay, %.0f%% of frees by another thread:\n",
+           mt_remote * 100.0);
+    if (tab_mode)
+        printf("threads\tKops\tspeedup\tmin thread Kops\tmax thread Kops\n");
+    else
+        printf("  %7s %9s %8s %17s\n", "threads", "Kops", "speedup", "thread Kops");
+
+    for (n = 1; n <= mt_threads; n++) {
+        double best_secs = DBL_MAX;
+        double ops = 0, kops, tmin = DBL_MAX, tmax = 0;
+
+        for (rep = 0; rep < MT_REPS; rep++) {
+            double secs = mt_run(threads, n);
+            if (secs < best_secs) {
+                best_secs = secs;
+                memcpy(best, threads, n * sizeof(mt_thread_t));
+            }
+        }
+        for (i = 0; i < n; i++) {
+            double tk = best[i].ops * 1e-3 / (best[i].end_time - best[i].start_time);
+            ops += best[i].ops;
+            tmin = tk < tmin ? tk : tmin;
+            tmax = tk > tmax ? tk : tmax;
+        }
+        kops = ops * 1e-3 / best_secs;
+        if (n == 1)
+            base_kops = kops;
+        printf(tab_mode ? "%d\t%.0f\t%.2f\t%.0f\t%.0f\n" : "  %7d %9.0f %7.2fx %8.0f-%-8.0f\n",
+               n, kops, kops / base_kops, tmin, tmax);
+    }
+
+    printf("\nPer thread at %d threads:\n", mt_threads);
+    if (tab_mode)
+        printf("thread\tops\tmsecs\tKops\ttrace\n");
+    else
+        printf("  %6s %9s %9s %9s  %s\n", "thread", "ops", "msecs", "Kops", "trace");
+    for (i = 0; i < mt_threads; i++) {
+        double secs = best[i].end_time - best[i].start_time;
+        printf(tab_mode ? "%d\t%ld\t%.3f\t%.0f\t%s\n" : "  %6d %9ld %9.3f %9.0f  %s\n",
+               i, best[i].ops, secs * 1000.0, best[i].ops * 1e-3 / secs,
+               best[i].trace->filename);
+        free_trace(threads[i].trace);
+    }
+
+    mem_deinit();
+    free(best);
+    free(threads);
+}
+
+/*
+ * stream_fill - decode up to STREAM_CHUNK requests into ops; returns
+ *    how many.  raw, raw_pos and raw_len hold the undecoded bytes of a
+ *    binary trace between calls.
+ */
+static int stream_fill(stream_t *st, traceop_t *ops, long *done,
+                       unsigned char *raw, size_t *raw_pos, size_t *raw_len,
+                       long *prev_index)
+{
+    int n = 0;
+    char type[MAXLINE];
+    int ignore = 0;
+
+    for (; n < STREAM_CHUNK && *done < st->num_ops; n++, (*done)++) {
+        traceop_t *op = &ops[n];
+
+        op->hint = 0;
+        op->size = 0;
+        if (st->binary) {
+            const unsigned char *p;
+            mrep_op_t mop;
+
+            /* Keep at least one whole record in the buffer */
+            if (*raw_len - *raw_pos < MREP_OP_MAX) {
+                memmove(raw, raw + *raw_pos, *raw_len - *raw_pos);
+                *raw_len -= *raw_pos;
+                *raw_pos = 0;
+                *raw_len += fread(raw + *raw_len, 1, STREAM_READ - *raw_len, st->file);
+            }
+            p = mrep_decode_op(raw + *raw_pos, raw + *raw_len, &mop, prev_index);
+            if (p == NULL)
+                app_error("Bad request %ld in streamed trace\n", *done);
+            *raw_pos = p - raw;
+            op->type = mop.type;
+            op->index = mop.index;
+            op->size = mop.size;
+        } else {
+            if (fscanf(st->file, "%s", type) != 1)
+                app_error("Streamed trace ends after %ld of %ld requests\n",
+                          *done, st->num_ops);
+            switch (type[0]) {
+                case 'a':
+                case 'r':
+                    op->type = type[0] == 'a' ? ALLOC : REALLOC;
+                    ignore += fscanf(st->file, "%ld %zu", &op->index, &op->size);
+                    break;
+                case 'f':
+                    op->type = FREE;
+                    ignore += fscanf(st->file, "%ld", &op->index);
+                    break;
+                default:
+                    app_error("Bogus type character (%c) in streamed trace\n", type[0]);
+            }
+        }
+    }
+    return n;
+}
+
+/*
+ * stream_reader - reader thread: fill the two buffers in turn
+ */
+static void *stream_reader(void *arg)
+{
+    stream_t *st = arg;
+    unsigned char *raw = NULL;
+    size_t raw_pos = 0, raw_len = 0;
+    long done = 0, prev_index = 0;
+    int b = 0, n;
+
+    if (st->binary && (raw = malloc(STREAM_READ)) == NULL)
+        unix_error("read buffer malloc failed in stream_reader");
+    do {
+        pthread_mutex_lock(&st->lock);
+        while (st->full[b])
+            pthread_cond_wait(&st->cond, &st->lock);
+        pthread_mutex_unlock(&st->lock);
+
+        n = stream_fill(st, st->ops[b], &done, raw, &raw_pos, &raw_len, &prev_index);
+
+        pthread_mutex_lock(&st->lock);
+        st->count[b] = n;
+        st->full[b] = true;
+        pthread_cond_broadcast(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+        b ^= 1;
+    } while (n == STREAM_CHUNK);
+    free(raw);
+    return NULL;
+}
+
+/*
+ * run_stream_replay - replay stream_file while it is being read, with
+ *    the live blocks in an id map instead of arrays sized by the
+ *    number of ids.  Reports throughput over the CPU time of the
+ *    replay thread (waits for the reader are not counted) and over
+ *    wall clock time, and the peak utilization.  Hints are not
+ *    available, since they need to look ahead in the trace.
+ */
+static void run_stream_replay(void)
+{
+    stream_t st;
+    idmap_t map;
+    idmap_slot_t *slot;
+    pthread_t reader;
+    struct timespec c0, c1;
+    double w0, w1, cpu_secs;
+    size_t total_size = 0, max_total_size = 0, max_heap_size = 0, peak_live = 0;
+    long ops = 0;
+    int b = 0, i, n;
+    char *p;
+
+    memset(&st, 0, sizeof(st));
+    if ((st.file = fopen(stream_file, "r")) == NULL)
+        unix_error("Could not open %s in run_stream_replay", stream_file);
+    st.binary = strlen(stream_file) >= strlen(MREP_SUFFIX) &&
+        strcmp(stream_file + strlen(stream_file) - strlen(MREP_SUFFIX), MREP_SUFFIX) == 0;
+    if (st.binary) {
+        mrep_header_t hdr;
+        if (fread(&hdr, sizeof(hdr), 1, st.file) != 1 || !mrep_check_header(&hdr))
+            app_error("%s: not a version %d binary trace\n", stream_file, MREP_VERSION);
+        st.num_ops = hdr.num_ops;
+    } else {
+        int weight, num_ids;
+        size_t data_bytes;
+        if (fscanf(st.file, "%d %d %ld %zu", &weight, &num_ids, &st.num_ops, &data_bytes) != 4)
+            app_error("%s: bad trace header\n", stream_file);
+    }
+    for (b = 0; b < 2; b++)
+        if ((st.ops[b] = malloc(STREAM_CHUNK * sizeof(traceop_t))) == NULL)
+            unix_error("ops malloc failed in run_stream_replay");
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.cond, NULL);
+    if (!idmap_init(&map, 16))
+        unix_error("id map malloc failed");
+
+    mem_init();
+    if (!mm_init())
+        app_error("mm_init failed in run_stream_replay");
+
+    w0 = wall_time();
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+    if (pthread_create(&reader, NULL, stream_reader, &st) != 0)
+        unix_error("pthread_create in run_stream_replay failed");
+
+    b = 0;
+    do {
+        pthread_mutex_lock(&st.lock);
+        while (!st.full[b])
+            pthread_cond_wait(&st.cond, &st.lock);
+        n = st.count[b];
+        pthread_mutex_unlock(&st.lock);
+
+        traceop_t *op = st.ops[b];
+        for (i = 0; i < n; i++, op++) {
+            switch (op->type) {
+
+                case ALLOC: /* mm_malloc */
+                    if ((p = mm_malloc(op->size)) == NULL)
+                        app_error("mm_malloc error in run_stream_replay");
+                    slot = idmap_find(&map, op->index);
+                    if (slot->key != IDMAP_EMPTY)
+                        total_size -= slot->size;
+                    if (!idmap_put(&map, op->index, (uintptr_t) p, op->size))
+                        unix_error("id map malloc failed");
+                    if (map.count > peak_live)
+                        peak_live = map.count;
+                    total_size += op->size;
+                    break;
+
+                case REALLOC: /* mm_realloc */
+                    slot = idmap_find(&map, op->index);
+                    if (slot->key != IDMAP_EMPTY) {
+                        total_size -= slot->size;
+                        p = mm_realloc((char *) slot->val, op->size);
+                    } else {
+                        p = mm_realloc(NULL, op->size);
+                    }
+                    if (p == NULL && op->size != 0)
+                        app_error("mm_realloc error in run_stream_replay");
+                    if (!idmap_put(&map, op->index, (uintptr_t) p, op->size))
+                        unix_error("id map malloc failed");
+                    if (map.count > peak_live)
+                        peak_live = map.count;
+                    total_size += op->size;
+                    break;
+
+                case FREE: /* mm_free */
+                    slot = op->index < 0 ? NULL : idmap_find(&map, op->index);
+                    if (slot == NULL || slot->key == IDMAP_EMPTY) {
+                        mm_free(NULL);
+                    } else {
+                        mm_free((char *) slot->val);
+                        total_size -= slot->size;
+                        idmap_remove(&map, slot);
+                    }
+                    break;
+
+                default:
+                    app_error("Nonexistent request type in run_stream_replay");
+            }
+            if (total_size > max_total_size)
+                max_total_size = total_size;
+        }
+        ops += n;
+        if (mem_heapsize() > max_heap_size)
+            max_heap_size = mem_heapsize();
+
+        pthread_mutex_lock(&st.lock);
+        st.full[b] = false;
+        pthread_cond_broadcast(&st.cond);
+        pthread_mutex_unlock(&st.lock);
+        b ^= 1;
+    } while (n == STREAM_CHUNK);
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+    w1 = wall_time();
+    pthread_join(reader, NULL);
+    cpu_secs = (c1.tv_sec - c0.tv_sec) + (c1.tv_nsec - c0.tv_nsec) * 1e-9;
+
+    printf("\nStreaming replay of %s:\n", stream_file);
+    if (tab_mode) {
+        printf("ops\tcpu secs\tKops\twall secs\twall Kops\tpeak live\tutil\n");
+        printf("%ld\t%.3f\t%.0f\t%.3f\t%.0f\t%zu\t%.1f\n", ops, cpu_secs,
+               ops * 1e-3 / cpu_secs, w1 - w0, ops * 1e-3 / (w1 - w0), peak_live,
+               max_heap_size ? 100.0 * max_total_size / max_heap_size : 0.0);
+    } else {
+        printf("  %12s %9s %9s %9s %9s %10s %6s\n", "ops", "cpu secs", "Kops",
+               "wall secs", "wall Kops", "peak live", "util");
+        printf("  %12ld %9.3f %9.0f %9.3f %9.0f %10zu %5.1f%%\n", ops, cpu_secs,
+               ops * 1e-3 / cpu_secs, w1 - w0, ops * 1e-3 / (w1 - w0), peak_live,
+               max_heap_size ? 100.0 * max_total_size / max_heap_size : 0.0);
+    }
+
+    mem_deinit();
+    idmap_destroy(&map);
+    free(st.ops[0]);
+    free(st.ops[1]);
+    pthread_mutex_destroy(&st.lock);
+    pthread_cond_destroy(&st.cond);
+    fclose(st.file);
+}
+
+/*
+ * run_policy_sweep - run all traces once per placement policy in
+ * policy_specs and print utilization and throughput side by side
+ */
+static void run_policy_sweep(speed_t *speed_params) {
+    int p, i;
+    int num_specs;
+    stats_t **stats;
+    sum_stats_t sum;
+
+    for (num_specs = 0; policy_specs[num_specs]; num_specs++)
+        ;
+    if ((stats = calloc(num_specs, sizeof(stats_t *))) == NULL)
+        unix_error("stats calloc in run_policy_sweep failed");
+
+    for (p = 0; p < num_specs; p++) {
+        if ((stats[p] = calloc(num_global_tracefiles, sizeof(stats_t))) == NULL)
+            unix_error("stats calloc in run_policy_sweep failed");
+        if (!mm_config_parse(policy_specs[p]))
+            app_error("Invalid allocator settings '%s'\n", policy_specs[p]);
+        if (verbose > 1)
+            printf("\nTesting mm malloc with %s\n", policy_specs[p]);
+        run_tests(num_global_tracefiles, tracedir, global_tracefiles,
+                  stats[p], speed_params);
+        if (verbose > 1) {
+            printf("\nResults for %s:\n", policy_specs[p]);
+            printresults(num_global_tracefiles, stats[p], &sum);
+        }
+    }
+
+    /* Per trace: util and Kops of every policy */
+    printf("\n\nPer-trace util%% / Kops for each policy:\n");
+    if (tab_mode) {
+        printf("trace");
+        for (p = 0; p < num_specs; p++)
+            printf("\t%s util\t%s Kops", policy_specs[p], policy_specs[p]);
+        printf("\n");
+    } else {
+        for (p = 0; p < num_specs; p++)
+            printf("  [%c] %s\n", 'a' + p, policy_specs[p]);
+        printf("%-24s", "trace");
+        for (p = 0; p < num_specs; p++)
+            printf("  %13c", 'a' + p);
+        printf("\n");
+    }
+    for (i = 0; i < num_global_tracefiles; i++) {
+        char *name = strrchr(stats[0][i].filename, '/');
+        name = name ? name + 1 : stats[0][i].filename;
+        printf(tab_mode ? "%s" : "%-24s", name);
+        for (p = 0; p < num_specs; p++) {
+            stats_t *st = &stats[p][i];
+            double kops = st->secs > 0 ? (st->ops * 1e-3) / st->secs : 0;
+            if (!st->valid)
+                printf(tab_mode ? "\t-\t-" : "  %13s", "-");
+            else if (tab_mode)
+                printf("\t%.1f\t%.0f", st->util * 100.0, kops);
+            else
+                printf("  %5.1f%% %6.0f", st->util * 100.0, kops);
+        }
+        printf("\n");
+    }
+
+    /* Weighted averages, as used for the performance index */
+    printf("\nSummary:\n");
+    printf(tab_mode ? "policy\tvalid\tutil\tKops\n" : "  %-36s %6s %7s %8s\n",
+           "policy", "valid", "util", "Kops");
+    for (p = 0; p < num_specs; p++) {
+        int numvalid = 0;
+        for (i = 0; i < num_global_tracefiles; i++)
+            numvalid += stats[p][i].valid;
+        sumresults(num_global_tracefiles, stats[p], &sum);
+        printf(tab_mode ? "%s\t%d/%d\t%.1f\t%.0f\n" : "  %-36s %3d/%-2d %6.1f%% %8.0f\n",
+               policy_specs[p], numvalid, num_global_tracefiles, sum.util, sum.tput);
+        free(stats[p]);
+    }
+    free(stats);
+}
+
 double score_component(double perf, double min_perf, double max_perf)
 {
     if (perf < min_perf) {
@@ -338,6 +1027,7 @@ int main(int argc, char **argv)
     double correctindex;
     double util_weight = 0, perf_weight = 0;
     int numcorrect;
+    int regressions = 0;       /* traces worse than the baseline (-b) */
 
     setbuf(stdout, 0);
     setbuf(stderr, 0);
@@ -356,7 +1046,7 @@ int main(int argc, char **argv)
     /*
      * Read and interpret the command line arguments
      */
-    while ((c = getopt(argc, argv, "d:f:c:s:t:v:hOVlDT")) != EOF) {
+    while ((c = getopt(argc, argv, "d:f:c:p:s:t:v:hH:OVlDTPLm:x:S:o:b:r:R:k:")) != EOF) {
         switch (c) {
 
             case 'f': /* Use one specific trace file only (relative to curr dir) */
@@ -406,6 +1096,71 @@ int main(int argc, char **argv)
                 tab_mode = true;
                 break;
 
+            case 'p': /* Allocator settings, see mm_config_parse */
+                if (!mm_config_parse(optarg))
+                    app_error("Invalid allocator settings '%s'\n", optarg);
+                break;
+
+            case 'H': /* Lifetime hints from alloc-to-free distances */
+                hint_dist = atol(optarg);
+                break;
+
+            case 'P': /* Compare all placement policies */
+                policy_sweep = true;
+                break;
+
+            case 'L': /* Per-operation latency percentiles */
+                latency_mode = true;
+                break;
+
+            case 'm': /* Multithreaded replay on up to <n> threads */
+                mt_threads = atoi(optarg);
+                if (mt_threads < 1)
+                    app_error("Invalid thread count '%s'\n", optarg);
+                break;
+
+            case 'S': /* Streaming replay of one (possibly huge) trace */
+                stream_file = optarg;
+                break;
+
+            case 'x': /* Fraction of frees done by another thread */
+                mt_remote = atof(optarg);
+                if (mt_remote < 0 || mt_remote > 1)
+                    app_error("Invalid remote free fraction '%s'\n", optarg);
+                break;
+
+            case 'o': /* Write per-trace results as JSON or CSV */
+                results_file = optarg;
+                break;
+
+            case 'b': /* Compare with the results file of a baseline */
+                baseline_file = optarg;
+                break;
+
+            case 'r': /* Number of timings of each trace */
+                result_samples = atoi(optarg);
+                if (result_samples < 1 || result_samples > RESULT_SAMPLES_MAX)
+                    app_error("Invalid number of timings '%s'\n", optarg);
+                break;
+
+            case 'R': /* Robust timing: median of <n> pinned samples */
+                robust_samples = atol(optarg);
+                if (robust_samples < 1)
+                    app_error("Invalid number of samples '%s'\n", optarg);
+                set_fcyc_robust(robust_samples);
+                break;
+
+            case 'k': /* Cache state for the timings */
+                for (i = 0; cache_modes[i] != NULL; i++) {
+                    if (strcmp(optarg, cache_modes[i]) == 0)
+                        break;
+                }
+                if (cache_modes[i] == NULL)
+                    app_error("Invalid cache mode '%s'\n", optarg);
+                cache_mode = (fcyc_cache_mode_t) i;
+                set_fcyc_cache_mode(cache_mode);
+                break;
+
             case 'h': /* Print this message */
                 usage(argv[0]);
                 exit(0);
@@ -417,6 +1172,10 @@ int main(int argc, char **argv)
     }
 #endif /* !REF_ONLY */
 
+    /* One timing per trace can't tell a regression from noise */
+    if ((results_file != NULL || baseline_file != NULL) && result_samples == 0)
+        result_samples = RESULT_SAMPLES;
+
     if (num_global_tracefiles == 0) {
         int i;
         for (i = 0; default_tracefiles[i]; i++)
@@ -427,6 +1186,28 @@ int main(int argc, char **argv)
         init_random_data();
     }
 
+    if (cache_mode != FCYC_CACHE_ANY && verbose > 0) {
+        const fcyc_cache_t *geo = fcyc_cache_geometry();
+        printf("Cache state for timing: %s (L1d %ld KB, L2 %ld KB, LLC %ld KB, %ld-byte lines)\n",
+               cache_modes[cache_mode], geo->l1d >> 10, geo->l2 >> 10,
+               geo->llc >> 10, geo->line);
+    }
+
+    if (policy_sweep) {
+        run_policy_sweep(&speed_params);
+        exit(errors ? 1 : 0);
+    }
+
+    if (mt_threads > 0) {
+        run_mt_replay();
+        exit(errors ? 1 : 0);
+    }
+
+    if (stream_file != NULL) {
+        run_stream_replay();
+        exit(errors ? 1 : 0);
+    }
+
     /* Initialize the timeout */
     if (set_timeout > 0) {
         signal(SIGALRM, timeout_handler);
@@ -496,6 +1277,12 @@ int main(int argc, char **argv)
     if (mm_stats == NULL)
         unix_error("mm_stats calloc in main failed");
 
+    if (latency_mode) {
+        latency_stats = calloc(num_global_tracefiles, sizeof(latency_t));
+        if (latency_stats == NULL)
+            unix_error("latency_stats calloc in main failed");
+    }
+
     run_tests(num_global_tracefiles, tracedir, global_tracefiles, mm_stats,
               &speed_params);
 
@@ -514,9 +1301,25 @@ int main(int argc, char **argv)
             printf("\nResults for mm malloc:\n");
             printresults(num_global_tracefiles, mm_stats, &global_mm_sum_stats);
             printf("\n");
+            if (latency_mode) {
+                printf("Latency for mm malloc (ns):\n");
+                printlatency(num_global_tracefiles, mm_stats, latency_stats);
+                printf("\n");
+            }
+            if (robust_samples > 0) {
+                printf("Robust timing of mm malloc (median of %ld samples):\n",
+                       robust_samples);
+                printrobust(num_global_tracefiles, mm_stats);
+                printf("\n");
+            }
         }
     }
 
+    if (results_file != NULL)
+        write_results(results_file, num_global_tracefiles, mm_stats, latency_stats);
+    if (baseline_file != NULL)
+        regressions = compare_baseline(baseline_file, num_global_tracefiles, mm_stats);
+
     /* Optionally compare the performance of mm and libc */
     if (run_libc) {
         printf("Comparison with libc malloc: mm/libc = %.0f Kops / %.0f Kops = %.2f\n", 
@@ -641,7 +1444,7 @@ int main(int argc, char **argv)
            (int)ceil(perfindex));
 #endif
 
-    exit(0);
+    exit(regressions > 0 ? EXIT_REGRESSION : 0);
 }
 
 
@@ -898,7 +1701,7 @@ static bool check_index(const trace_t *trace, int opnum, int index, int realloc)
 static trace_t *read_trace(stats_t *stats, const char *tracedir,
                            const char *filename)
 {
-    FILE *tracefile;
+    FILE *tracefile = NULL;
     trace_t *trace;
     char type[MAXLINE];
     int index;
@@ -906,6 +1709,12 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     int max_index = 0;
     int op_index;
     int ignore = 0;
+    size_t len = strlen(filename);
+    bool binary = len >= strlen(MREP_SUFFIX) &&
+        strcmp(filename + len - strlen(MREP_SUFFIX), MREP_SUFFIX) == 0;
+    unsigned char *map = NULL;
+    size_t map_len = 0;
+    const mrep_header_t *hdr = NULL;
 
     if (verbose > 1)
         printf("Reading tracefile: %s\n", filename);
@@ -917,15 +1726,40 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     /* Read the trace file header */
     strcpy(trace->filename, tracedir);
     strcat(trace->filename, filename);
-    if ((tracefile = fopen(trace->filename, "r")) == NULL) {
-        unix_error("Could not open %s in read_trace", trace->filename);
+    if (binary) {
+        /* Binary trace: map it and decode the requests in one pass */
+        struct stat st;
+        int fd = open(trace->filename, O_RDONLY);
+        if (fd < 0 || fstat(fd, &st) < 0)
+            unix_error("Could not open %s in read_trace", trace->filename);
+        map_len = st.st_size;
+        if (map_len < sizeof(mrep_header_t))
+            app_error("%s: truncated header\n", trace->filename);
+        map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+            unix_error("Could not map %s in read_trace", trace->filename);
+        close(fd);
+        madvise(map, map_len, MADV_SEQUENTIAL);
+        hdr = (const mrep_header_t *) map;
+        if (!mrep_check_header(hdr) || hdr->num_ops > INT_MAX ||
+            hdr->num_ids > INT_MAX || hdr->body_bytes > map_len - sizeof(*hdr))
+            app_error("%s: not a version %d binary trace\n",
+                      trace->filename, MREP_VERSION);
+        trace->weight = hdr->weight;
+        trace->num_ids = hdr->num_ids;
+        trace->num_ops = hdr->num_ops;
+        trace->data_bytes = hdr->data_bytes;
+    } else {
+        if ((tracefile = fopen(trace->filename, "r")) == NULL) {
+            unix_error("Could not open %s in read_trace", trace->filename);
+        }
+        int iweight;
+        ignore += fscanf(tracefile, "%d", &iweight);
+        trace->weight = iweight;
+        ignore += fscanf(tracefile, "%d", &trace->num_ids);
+        ignore +=  fscanf(tracefile, "%d", &trace->num_ops);
+        ignore +=  fscanf(tracefile, "%zd", &trace->data_bytes);
     }
-    int iweight;
-    ignore += fscanf(tracefile, "%d", &iweight);
-    trace->weight = iweight;
-    ignore += fscanf(tracefile, "%d", &trace->num_ids);
-    ignore +=  fscanf(tracefile, "%d", &trace->num_ops);
-    ignore +=  fscanf(tracefile, "%zd", &trace->data_bytes);
 
     if (((unsigned int)trace->weight) > 3u) {
         app_error("%s: weight can only be in {0, 1, 2 3}", trace->filename);
@@ -952,16 +1786,36 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
         unix_error("malloc 5 failed in read_trace");
 
 
-    /* read every request line in the trace file */
     index = 0;
     op_index = 0;
-    while (fscanf(tracefile, "%s", type) != EOF) {
+    if (binary) {
+        const unsigned char *p = map + sizeof(*hdr);
+        const unsigned char *end = p + hdr->body_bytes;
+        long prev_index = 0;
+        mrep_op_t op;
+
+        for (; op_index < trace->num_ops; op_index++) {
+            if ((p = mrep_decode_op(p, end, &op, &prev_index)) == NULL)
+                app_error("%s: bad request %d\n", trace->filename, op_index);
+            trace->ops[op_index].type = op.type;
+            trace->ops[op_index].index = op.index;
+            trace->ops[op_index].size = op.size;
+            trace->ops[op_index].hint = 0;
+            if (op.type != MREP_FREE)
+                max_index = (op.index > max_index) ? op.index : max_index;
+        }
+        munmap(map, map_len);
+    }
+
+    /* read every request line in the trace file */
+    while (!binary && fscanf(tracefile, "%s", type) != EOF) {
         switch(type[0]) {
             case 'a':
                 ignore += fscanf(tracefile, "%u %lu", &index, &size);
                 trace->ops[op_index].type = ALLOC;
                 trace->ops[op_index].index = index;
                 trace->ops[op_index].size = size;
+                trace->ops[op_index].hint = 0;
                 max_index = (index > max_index) ? index : max_index;
                 break;
             case 'r':
@@ -983,10 +1837,14 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
         op_index++;
         if (op_index == trace->num_ops) break;
     }
-    fclose(tracefile);
+    if (!binary)
+        fclose(tracefile);
     assert(max_index == trace->num_ids - 1);
     assert(trace->num_ops == op_index);
 
+    if (hint_dist > 0)
+        hint_trace(trace);
+
     /* fill in the stats */
     strcpy(stats->filename, trace->filename);
     stats->weight = trace->weight;
@@ -995,6 +1853,62 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     return trace;
 }
 
+/*
+ * hint_trace - lifetime analysis: mark each allocation whose block is
+ * freed within hint_dist ops (reallocs don't end a lifetime) as
+ * MM_HINT_SHORT, all others as MM_HINT_LONG
+ */
+static void hint_trace(trace_t *trace)
+{
+    int i, index;
+    int num_short = 0, num_long = 0;
+    int *born;
+
+    if ((born = malloc(trace->num_ids * sizeof(int))) == NULL)
+        unix_error("malloc failed in hint_trace");
+    for (i = 0; i < trace->num_ids; i++)
+        born[i] = -1;
+
+    for (i = 0; i < trace->num_ops; i++) {
+        index = trace->ops[i].index;
+        switch (trace->ops[i].type) {
+            case ALLOC:
+                born[index] = i;
+                break;
+            case FREE:
+                if (index >= 0 && born[index] >= 0) {
+                    bool is_short = (i - born[index] <= hint_dist);
+                    trace->ops[born[index]].hint = is_short ? MM_HINT_SHORT : MM_HINT_LONG;
+                    num_short += is_short;
+                    num_long += !is_short;
+                    born[index] = -1;
+                }
+                break;
+            case REALLOC:
+                break;
+        }
+    }
+    for (i = 0; i < trace->num_ids; i++) {
+        if (born[i] >= 0) {
+            trace->ops[born[i]].hint = MM_HINT_LONG;
+            num_long++;
+        }
+    }
+    free(born);
+
+    if (verbose > 1)
+        printf("Lifetime hints: %d short, %d long (freed within %ld ops)\n",
+               num_short, num_long, hint_dist);
+}
+
+/*
+ * hinted_malloc - mm_malloc, or mm_malloc_hint if the trace was analyzed
+ */
+static inline void *hinted_malloc(size_t size, int hint)
+{
+    return hint ? mm_malloc_hint(size, hint) : mm_malloc(size);
+}
+
 /*
  * reinit_trace - get the trace ready for another run.
  */
@@ -1053,8 +1967,9 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
         if (debug_mode == DBG_EXPENSIVE) {
             range_t *r;
                         
-            /* Let the students check their own heap */
-            if (!mm_checkheap(0)) {
+            /* Let the students check their own heap (a no-op unless
+               mm.c is built with DEBUG, as in mdriver-dbg) */
+            if (!mm_checkheap(LINENUM(i))) {
                 malloc_error(trace, i, "mm_checkheap returned false\n");
                 return false;
             };
@@ -1073,7 +1988,7 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
             case ALLOC: /* mm_malloc */
 
                 /* Call the student's malloc */
-                if ((p = mm_malloc(size)) == NULL) {
+                if ((p = hinted_malloc(size, trace->ops[i].hint)) == NULL) {
                     malloc_error(trace, i, "mm_malloc failed.");
                     return false;
                 }
@@ -1171,7 +2086,7 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
  *
  *   A higher number is better: 1 is optimal.
  */
-static double eval_mm_util(trace_t *trace, int tracenum)
+static double eval_mm_util(trace_t *trace, int tracenum, size_t *heap)
 {
     int i;
     int index;
@@ -1197,7 +2112,7 @@ static double eval_mm_util(trace_t *trace, int tracenum)
                 index = trace->ops[i].index;
                 size = trace->ops[i].size;
 
-                if ((p = mm_malloc(size)) == NULL) {
+                if ((p = hinted_malloc(size, trace->ops[i].hint)) == NULL) {
                     app_error("trace %d: mm_malloc failed in eval_mm_util",
                               tracenum);
                 }
@@ -1259,6 +2174,7 @@ static double eval_mm_util(trace_t *trace, int tracenum)
     printf(".");
 #endif
 
+    *heap = max_heap_size;
     return ((double)max_total_size / (double)max_heap_size);
 }
 
@@ -1287,7 +2203,7 @@ static void eval_mm_speed(void *ptr)
             case ALLOC: /* mm_malloc */
                 index = trace->ops[i].index;
                 size = trace->ops[i].size;
-                if ((p = mm_malloc(size)) == NULL)
+                if ((p = hinted_malloc(size, trace->ops[i].hint)) == NULL)
                     app_error("mm_malloc error in eval_mm_speed");
                 trace->blocks[index] = p;
                 break;
@@ -1316,6 +2232,70 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+/*
+ * eval_mm_latency - Replay the trace once more, reading the tick
+ *    counter around every request and recording the difference (less
+ *    the cost of reading the counter) in the histogram for its type.
+ *    Done separately from eval_mm_speed so it does not slow down the
+ *    throughput measurement.
+ */
+static void eval_mm_latency(trace_t *trace, latency_t *lat)
+{
+    int i, index;
+    size_t size;
+    char *p, *block;
+    unsigned long long start, ticks;
+    unsigned long long overhead = ticks_overhead();
+
+    for (i = 0; i < 3; i++)
+        hist_reset(&lat->op[i]);
+    reinit_trace(trace);
+
+    /* Reset the heap and initialize the mm package */
+    mem_reset_brk();
+    if (!mm_init())
+        app_error("mm_init failed in eval_mm_latency");
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+        index = trace->ops[i].index;
+        switch (trace->ops[i].type) {
+
+            case ALLOC: /* mm_malloc */
+                size = trace->ops[i].size;
+                start = read_ticks();
+                p = hinted_malloc(size, trace->ops[i].hint);
+                ticks = read_ticks() - start;
+                if (p == NULL)
+                    app_error("mm_malloc error in eval_mm_latency");
+                trace->blocks[index] = p;
+                break;
+
+            case REALLOC: /* mm_realloc */
+                size = trace->ops[i].size;
+                start = read_ticks();
+                p = mm_realloc(trace->blocks[index], size);
+                ticks = read_ticks() - start;
+                if (p == NULL && size != 0)
+                    app_error("mm_realloc error in eval_mm_latency");
+                trace->blocks[index] = p;
+                break;
+
+            case FREE: /* mm_free */
+                block = index < 0 ? NULL : trace->blocks[index];
+                start = read_ticks();
+                mm_free(block);
+                ticks = read_ticks() - start;
+                break;
+
+            default:
+                app_error("Nonexistent request type in eval_mm_latency");
+                return;
+        }
+        hist_add(&lat->op[trace->ops[i].type],
+                 ticks > overhead ? ticks - overhead : 0);
+    }
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -1420,6 +2400,40 @@ static void eval_libc_speed(void *ptr)
  ************************************/
 
 
+/*
+ * sumresults - computes the weighted summary statistics of a set of
+ *              traces (util in percent, tput in Kops), like printresults
+ */
+static void sumresults(int n, stats_t *stats, sum_stats_t *sumstats)
+{
+    int i;
+    double sumsecs = 0;
+    double sumops  = 0;
+    double sumutil = 0;
+    int sum_perf_weight = 0;
+    int sum_util_weight = 0;
+
+    for (i=0; i < n; i++) {
+        if (!stats[i].valid)
+            continue;
+        if (stats[i].weight == WALL || stats[i].weight == WPERF) {
+            sum_perf_weight += 1;
+            sumsecs += stats[i].secs;
+            sumops += stats[i].ops;
+        }
+        if (stats[i].weight == WALL || stats[i].weight == WUTIL) {
+            sum_util_weight += 1;
+            sumutil += stats[i].util;
+        }
+    }
+    if (sum_util_weight == 0)
+        sum_util_weight = 1;
+    sumstats->util = (sumutil/(double)sum_util_weight)*100.0;
+    sumstats->ops = sumops;
+    sumstats->secs = sumsecs;
+    sumstats->tput = (sumsecs==0.0) ? 0 : (sumops/1e3)/sumsecs;
+}
+
 /*
  * printresults - prints a performance summary for some malloc package and returns
  *                a summary of the stats to the caller. 
@@ -1585,6 +2599,423 @@ static void printresults(int n, stats_t *stats, sum_stats_t *sumstats)
     }
 }
 
+/*
+ * printlatency - print latency percentiles for every operation type
+ *                of every valid trace, then for all traces together
+ */
+static void printlatency(int n, stats_t *stats, latency_t *lat)
+{
+    static const char *op_names[3] = { "malloc", "free", "realloc" };
+    static const double pcts[4] = { 50, 90, 99, 99.9 };
+    double per_ns = ticks_per_ns();
+    latency_t all;
+    int i, t, j;
+
+    if (tab_mode) {
+        printf("op\tcount\tp50\tp90\tp99\tp99.9\tmax\ttrace\n");
+    } else {
+        printf("  %-8s%9s%8s%8s%8s%8s%9s  %s\n",
+               "op", "count", "p50", "p90", "p99", "p99.9", "max", "trace");
+    }
+    for (t = 0; t < 3; t++)
+        hist_reset(&all.op[t]);
+    for (i = 0; i <= n; i++) {
+        latency_t *l = i < n ? &lat[i] : &all;
+        const char *name = i < n ? stats[i].filename : "all traces";
+
+        if (i < n) {
+            if (!stats[i].valid)
+                continue;
+            for (t = 0; t < 3; t++)
+                hist_merge(&all.op[t], &lat[i].op[t]);
+        }
+        for (t = 0; t < 3; t++) {
+            hist_t *h = &l->op[t];
+            if (h->count == 0)
+                continue;
+            printf(tab_mode ? "%s\t%llu" : "  %-8s%9llu", op_names[t], h->count);
+            for (j = 0; j < 4; j++)
+                printf(tab_mode ? "\t%.0f" : "%8.0f",
+                       hist_percentile(h, pcts[j]) / per_ns);
+            printf(tab_mode ? "\t%.0f\t%s\n" : "%9.0f  %s\n",
+                   h->max / per_ns, name);
+        }
+    }
+}
+
+/*
+ * printrobust - print the throughput of every valid trace as the median
+ *               of robust mode, with the MAD and the bootstrap interval
+ */
+static void printrobust(int n, stats_t *stats)
+{
+    int i;
+
+    if (tab_mode) {
+        printf("Kops\tmad%%\tci_lo\tci_hi\ttrace\n");
+    } else {
+        printf("  %9s %6s %9s %9s  %s\n", "Kops", "MAD", "95% CI", "", "trace");
+    }
+    for (i = 0; i < n; i++) {
+        fcyc_stats_t *r = &stats[i].robust;
+        double kops = stats[i].ops * 1e-3;
+
+        if (!stats[i].valid || r->samples == 0)
+            continue;
+        /* Times to throughput: the slow end of the interval comes first */
+        printf(tab_mode ? "%.0f\t%.2f\t%.0f\t%.0f\t%s\n"
+                        : "  %9.0f %5.2f%% %9.0f %9.0f  %s\n",
+               kops / r->median, 100.0 * r->mad / r->median,
+               kops / r->ci_hi, kops / r->ci_lo, stats[i].filename);
+    }
+}
+
+/*
+ * Results files (-o) and the comparison with a baseline (-b)
+ *
+ * A JSON results file holds one object per trace, each on a line of
+ * its own; a CSV file has one row per trace after a header row.  Both
+ * have the throughput of every timing (kops_samples), which is what
+ * compare_baseline needs for its t-test, and the latency percentiles
+ * in ns if -L was given.
+ */
+
+/* Baseline results of one trace, as read back by read_baseline */
+typedef struct {
+    char trace[MAXLINE];
+    bool valid;
+    double util;
+    int num_samples;
+    double kops[RESULT_SAMPLES_MAX];
+} baseline_t;
+
+static const char *result_op_names[3] = { "malloc", "free", "realloc" };
+static const char *result_pct_names[4] = { "p50", "p90", "p99", "p99.9" };
+static const double result_pcts[4] = { 50, 90, 99, 99.9 };
+
+/* True if file name ends in .csv */
+static bool is_csv(const char *file)
+{
+    size_t len = strlen(file);
+
+    return len >= 4 && strcmp(file + len - 4, ".csv") == 0;
+}
+
+/* Print s as a JSON string, or as a CSV field if csv */
+static void print_quoted(FILE *f, const char *s, bool csv)
+{
+    if (csv && strpbrk(s, ",\"\n") == NULL) {
+        fputs(s, f);
+        return;
+    }
+    fputc('"', f);
+    for (; *s != '\0'; s++) {
+        if (*s == '"')
+            fputs(csv ? "\"\"" : "\\\"", f);
+        else if (*s == '\\' && !csv)
+            fputs("\\\\", f);
+        else
+            fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+/*
+ * write_results - write the stats of the n traces to file, as CSV if
+ *                 its name ends in .csv and as JSON otherwise
+ */
+static void write_results(const char *file, int n, stats_t *stats, latency_t *lat)
+{
+    bool csv = is_csv(file);
+    double per_ns = lat != NULL ? ticks_per_ns() : 1.0;
+    FILE *f;
+    int i, j, t;
+
+    if ((f = fopen(file, "w")) == NULL)
+        unix_error("Could not create results file %s", file);
+
+    if (csv) {
+        fprintf(f, "trace,weight,valid,ops,secs,kops,util,heap_bytes,kops_samples");
+        for (t = 0; t < 3; t++) {
+            for (j = 0; j < 4; j++)
+                fprintf(f, ",%s_%s", result_op_names[t], result_pct_names[j]);
+            fprintf(f, ",%s_max", result_op_names[t]);
+        }
+        fprintf(f, "\n");
+    } else {
+        fprintf(f, "{\n\"traces\": [\n");
+    }
+
+    for (i = 0; i < n; i++) {
+        stats_t *st = &stats[i];
+        double kops = st->valid ? st->ops * 1e-3 / st->secs : 0.0;
+
+        if (csv) {
+            print_quoted(f, st->filename, true);
+            fprintf(f, ",%d,%d,%.0f,%.9g,%.6g,%.6f,%zu,", st->weight, st->valid,
+                    st->ops, st->valid ? st->secs : 0.0, kops, st->valid ? st->util : 0.0,
+                    st->valid ? st->heap : 0);
+            for (j = 0; st->valid && j < st->num_samples; j++)
+                fprintf(f, "%s%.6g", j > 0 ? ";" : "", st->kops[j]);
+            for (t = 0; t < 3; t++) {
+                hist_t *h = lat != NULL && st->valid ? &lat[i].op[t] : NULL;
+                for (j = 0; j < 5; j++) {
+                    if (h == NULL || h->count == 0)
+                        fprintf(f, ",");
+                    else
+                        fprintf(f, ",%.0f", (j < 4 ? hist_percentile(h, result_pcts[j])
+                                             : h->max) / per_ns);
+                }
+            }
+            fprintf(f, "\n");
+            continue;
+        }
+
+        fprintf(f, "{\"trace\": ");
+        print_quoted(f, st->filename, false);
+        fprintf(f, ", \"weight\": %d, \"valid\": %s, \"ops\": %.0f", st->weight,
+                st->valid ? "true" : "false", st->ops);
+        if (st->valid) {
+            fprintf(f, ", \"secs\": %.9g, \"kops\": %.6g, \"util\": %.6f, \"heap_bytes\": %zu",
+                    st->secs, kops, st->util, st->heap);
+            fprintf(f, ", \"kops_samples\": [");
+            for (j = 0; j < st->num_samples; j++)
+                fprintf(f, "%s%.6g", j > 0 ? ", " : "", st->kops[j]);
+            fprintf(f, "]");
+            if (lat != NULL) {
+                bool first = true;
+                fprintf(f, ", \"latency_ns\": {");
+                for (t = 0; t < 3; t++) {
+                    hist_t *h = &lat[i].op[t];
+                    if (h->count == 0)
+                        continue;
+                    fprintf(f, "%s\"%s\": {\"count\": %llu", first ? "" : ", ",
+                            result_op_names[t], h->count);
+                    for (j = 0; j < 4; j++)
+                        fprintf(f, ", \"%s\": %.0f", result_pct_names[j],
+                                hist_percentile(h, result_pcts[j]) / per_ns);
+                    fprintf(f, ", \"max\": %.0f}", h->max / per_ns);
+                    first = false;
+                }
+                fprintf(f, "}");
+            }
+        }
+        fprintf(f, "}%s\n", i < n - 1 ? "," : "");
+    }
+
+    if (!csv)
+        fprintf(f, "]\n}\n");
+    if (fclose(f) != 0)
+        unix_error("Could not write results file %s", file);
+}
+
+/* Parse a quoted string at p into buf; returns the end, NULL if bad */
+static const char *parse_quoted(const char *p, char *buf, bool csv)
+{
+    size_t len = 0;
+
+    if (*p++ != '"')
+        return NULL;
+    while (*p != '\0' && *p != '\n') {
+        if (*p == '"' && !(csv && p[1] == '"'))
+            break;
+        if ((*p == '"' && csv) || (*p == '\\' && !csv && p[1] != '\0'))
+            p++;
+        if (len < MAXLINE - 1)
+            buf[len++] = *p;
+        p++;
+    }
+    buf[len] = '\0';
+    return *p == '"' ? p + 1 : NULL;
+}
+
+/* Parse a list of at most RESULT_SAMPLES_MAX numbers separated by sep */
+static int parse_samples(const char *p, char sep, double *kops)
+{
+    int n = 0;
+    char *end;
+
+    while (n < RESULT_SAMPLES_MAX) {
+        while (*p == ' ')
+            p++;
+        kops[n] = strtod(p, &end);
+        if (end == p)
+            break;
+        n++;
+        p = end;
+        while (*p == ' ')
+            p++;
+        if (*p != sep)
+            break;
+        p++;
+    }
+    return n;
+}
+
+/* Parse one line of a JSON results file; false if it has no trace */
+static bool parse_json_result(const char *line, baseline_t *b)
+{
+    const char *p;
+
+    if ((p = strstr(line, "\"trace\": ")) == NULL ||
+        parse_quoted(p + 9, b->trace, false) == NULL)
+        return false;
+    b->valid = strstr(line, "\"valid\": true") != NULL;
+    b->util = (p = strstr(line, "\"util\": ")) != NULL ? atof(p + 8) : 0.0;
+    b->num_samples = (p = strstr(line, "\"kops_samples\": [")) != NULL
+        ? parse_samples(p + 17, ',', b->kops) : 0;
+    return true;
+}
+
+/* Parse one row of a CSV results file; false if it is not a trace */
+static bool parse_csv_result(const char *line, baseline_t *b)
+{
+    const char *p = line;
+    int field;
+
+    if (*p == '"') {
+        if ((p = parse_quoted(p, b->trace, true)) == NULL)
+            return false;
+    } else {
+        size_t len = strcspn(p, ",\n");
+        if (len >= MAXLINE)
+            return false;
+        memcpy(b->trace, p, len);
+        b->trace[len] = '\0';
+        p += len;
+    }
+    /* trace,weight,valid,ops,secs,kops,util,heap_bytes,kops_samples,... */
+    for (field = 1; field <= 8 && *p == ','; field++) {
+        p++;
+        if (field == 2)
+            b->valid = atoi(p) != 0;
+        else if (field == 6)
+            b->util = atof(p);
+        else if (field == 8)
+            b->num_samples = parse_samples(p, ';', b->kops);
+        if (field < 8)
+            p += strcspn(p, ",\n");
+    }
+    return field > 8;
+}
+
+/* Read the results file of a baseline; returns the number of traces */
+static int read_baseline(const char *file, baseline_t **out)
+{
+    bool csv = is_csv(file);
+    baseline_t *b = NULL;
+    int n = 0, cap = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    bool header = csv;
+    FILE *f;
+
+    if ((f = fopen(file, "r")) == NULL)
+        unix_error("Could not open baseline file %s", file);
+    while (getline(&line, &line_cap, f) > 0) {
+        if (header) {
+            header = false;
+            continue;
+        }
+        if (n == cap) {
+            cap = cap ? 2 * cap : 16;
+            if ((b = realloc(b, cap * sizeof(baseline_t))) == NULL)
+                unix_error("Could not allocate the baseline");
+        }
+        memset(&b[n], 0, sizeof(b[n]));
+        if (csv ? parse_csv_result(line, &b[n]) : parse_json_result(line, &b[n]))
+            n++;
+    }
+    free(line);
+    fclose(f);
+    if (n == 0)
+        app_error("No trace results in baseline file %s\n", file);
+    *out = b;
+    return n;
+}
+
+/*
+ * compare_baseline - compare the stats of the n traces with the results
+ *    in file and print a table.  A trace regressed if its throughput is
+ *    lower by at least RESULT_MIN_CHANGE with p < RESULT_ALPHA in
+ *    Welch's t-test, if its utilization dropped by more than
+ *    RESULT_UTIL_DROP, or if it was valid and isn't anymore.  Returns
+ *    the number of traces that regressed.
+ */
+static int compare_baseline(const char *file, int n, stats_t *stats)
+{
+    baseline_t *base;
+    int num_base = read_baseline(file, &base);
+    int i, k, regressions = 0;
+
+    printf("\nComparison with %s:\n", file);
+    if (tab_mode) {
+        printf("base_kops\tkops\tchange\tp\tbase_util\tutil\tverdict\ttrace\n");
+    } else {
+        printf("  %9s %9s %7s %7s %7s %7s  %-10s %s\n", "base Kops", "Kops",
+               "change", "p", "b.util", "util", "verdict", "trace");
+    }
+    for (i = 0; i < n; i++) {
+        stats_t *st = &stats[i];
+        baseline_t *b = NULL;
+        double bmean, bvar, mean, var, change, p;
+        char pstr[16];
+        const char *verdict;
+        bool regressed = false;
+
+        for (k = 0; k < num_base && b == NULL; k++) {
+            if (strcmp(base[k].trace, st->filename) == 0)
+                b = &base[k];
+        }
+        if (b == NULL || !b->valid || !st->valid) {
+            verdict = b == NULL ? "new" : !st->valid ? "INVALID" : "fixed";
+            regressed = b != NULL && b->valid && !st->valid;
+            if (tab_mode)
+                printf("\t\t\t\t\t\t%s\t%s\n", verdict, st->filename);
+            else
+                printf("  %9s %9s %7s %7s %7s %7s  %-10s %s\n",
+                       "-", "-", "-", "-", "-", "-", verdict, st->filename);
+            regressions += regressed;
+            continue;
+        }
+
+        ttest_moments(b->kops, b->num_samples, &bmean, &bvar);
+        ttest_moments(st->kops, st->num_samples, &mean, &var);
+        change = bmean > 0 ? mean / bmean - 1.0 : 0.0;
+        p = ttest_welch(st->kops, st->num_samples, b->kops, b->num_samples, NULL);
+        if (b->util - st->util > RESULT_UTIL_DROP) {
+            verdict = "UTIL";
+            regressed = true;
+        } else if (p >= 0 && p < RESULT_ALPHA && change <= -RESULT_MIN_CHANGE) {
+            verdict = "SLOWER";
+            regressed = true;
+        } else if (p >= 0 && p < RESULT_ALPHA && change >= RESULT_MIN_CHANGE) {
+            verdict = "faster";
+        } else {
+            verdict = p < 0 ? "too few" : "same";
+        }
+        regressions += regressed;
+
+        if (p < 0)
+            strcpy(pstr, "-");
+        else
+            snprintf(pstr, sizeof(pstr), "%.4f", p);
+        if (tab_mode) {
+            printf("%.0f\t%.0f\t%.1f\t%s\t%.1f\t%.1f\t%s\t%s\n", bmean, mean,
+                   change * 100.0, pstr, b->util * 100.0, st->util * 100.0,
+                   verdict, st->filename);
+        } else {
+            printf("  %9.0f %9.0f %+6.1f%% %7s %6.1f%% %6.1f%%  %-10s %s\n",
+                   bmean, mean, change * 100.0, pstr, b->util * 100.0,
+                   st->util * 100.0, verdict, st->filename);
+        }
+    }
+    printf("%d of %d traces regressed (p < %g, throughput change of %.0f%% or more)\n\n",
+           regressions, n, RESULT_ALPHA, RESULT_MIN_CHANGE * 100.0);
+    free(base);
+    return regressions;
+}
+
 /*
  * app_error - Report an arbitrary application error
  */
@@ -1796,17 +3227,32 @@ static double measure_ref_throughput() {
  */
 static void usage(char *prog)
 {
-    fprintf(stderr, "Usage: %s [-hlVdD] [-f <file>]\n", prog);
+    fprintf(stderr, "Usage: %s [-hlLVdD] [-f <file>]\n", prog);
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-d <i>     Debug: 0 off; 1 default; 2 lots.\n");
     fprintf(stderr, "\t-D         Equivalent to -d2.\n");
     fprintf(stderr, "\t-c <file>  Run trace file <file> once, check for correctness only.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-H <n>     Hint allocations freed within <n> ops as short-lived.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-m <n>     Replay traces on 1..n threads at once instead of grading.\n");
+    fprintf(stderr, "\t-x <f>     With -m, hand fraction <f> of frees to another thread.\n");
+    fprintf(stderr, "\t-L         Report per-operation latency percentiles.\n");
+    fprintf(stderr, "\t-p <set>   Allocator settings, e.g. fit=best,split=low (see mm.h).\n");
+    fprintf(stderr, "\t-P         Compare all placement policies instead of grading.\n");
     fprintf(stderr, "\t-V         Print diagnostics as each trace is run.\n");
     fprintf(stderr, "\t-v <i>     Set Verbosity Level to <i>\n");
     fprintf(stderr, "\t-s <s>     Timeout after s secs (default no timeout)\n");
+    fprintf(stderr, "\t-S <file>  Replay <file> while reading it, for traces too big to load.\n");
     fprintf(stderr, "\t-T         Print diagnostics in tab mode\n");
-    fprintf(stderr, "\t-f <file>  Use <file> as the trace file\n");
+    fprintf(stderr, "\t-f <file>  Use <file> as the trace file (.rep, or binary .mrep)\n");
+    fprintf(stderr, "\t-o <file>  Write per-trace results to <file> (.json or .csv).\n");
+    fprintf(stderr, "\t-b <file>  Compare with the results of a baseline, written by -o;\n");
+    fprintf(stderr, "\t           exit with status %d if a trace got significantly worse.\n", EXIT_REGRESSION);
+    fprintf(stderr, "\t-r <n>     Time each trace <n> times (default %d with -o or -b).\n", RESULT_SAMPLES);
+    fprintf(stderr, "\t-R <n>     Robust timing: warm up, pin to a CPU, take the median of <n>\n");
+    fprintf(stderr, "\t           samples and report its MAD and 95%% bootstrap interval.\n");
+    fprintf(stderr, "\t-k <mode>  Cache state when timing: any (default), cold, warm or\n");
+    fprintf(stderr, "\t           thrash (a thread streams through the LLC meanwhile).\n");
 }
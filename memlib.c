@@ -3,6 +3,10 @@
  * because it allows us to interleave calls from the student's malloc
  * package with the system's malloc package in libc.
  *
+ * In the shared library build (no DRIVER) the heap is a real one:
+ * the address range is reserved without access and committed in
+ * MEM_COMMIT steps as the break moves up, so untouched parts of the
+ * range cost neither memory nor swap reservations.
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,6 +18,9 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdint.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 #include "memlib.h"
 #include "config.h"
@@ -22,14 +29,27 @@
 static unsigned char *heap;                 /* Starting address of heap */
 static unsigned char *mem_brk;              /* Current position of break */
 static unsigned char *mem_max_addr;         /* Maximum allowable heap address */
+static unsigned char *mem_max_brk;          /* Highest break ever reached since mem_init */
+static bool mem_last_fresh;                 /* Was the last mem_sbrk area never used before? */
+#ifndef DRIVER
+static unsigned char *mem_committed;        /* End of the accessible part of the heap */
+
+/* Granularity of committing the reserved heap range */
+#define MEM_COMMIT (1 << 20)
+#endif
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(){
+#ifdef DRIVER
+    int prot = PROT_READ | PROT_WRITE;
+#else
+    int prot = PROT_NONE;                   /* committed by mem_sbrk */
+#endif
     unsigned char* addr = mmap(NULL,                                        /* start*/
                                MAX_HEAP_SIZE,                               /* length */
-                               PROT_READ | PROT_WRITE,                      /* permissions */
+                               prot,                                        /* permissions */
                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, /* flags */
                                -1,                                          /* fd */
                                0);                                          /* offset */
@@ -39,6 +59,10 @@ void mem_init(){
     }
     heap = addr;
     mem_max_addr = addr + MAX_HEAP_SIZE;
+    mem_max_brk = addr;
+#ifndef DRIVER
+    mem_committed = addr;
+#endif
     mem_reset_brk();
 }
 
@@ -73,11 +97,30 @@ void *mem_sbrk(intptr_t incr) {
 	fprintf(stderr, "ERROR: mem_sbrk failed.  Attempt to expand heap by negative value %ld\n", (long) incr);
     } else if (mem_brk + incr > mem_max_addr) {
 	ok = false;
+#ifdef DRIVER
 	long alloc = mem_brk - heap + incr;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory.  Would require heap size of %zd (0x%zx) bytes\n", alloc, alloc);
+#endif
+    }
+#ifndef DRIVER
+    else if (mem_brk + incr > mem_committed) {
+	/* Commit whole MEM_COMMIT steps, without passing the reservation */
+	size_t need = mem_brk + incr - mem_committed;
+	size_t step = (need + MEM_COMMIT - 1) & ~(size_t) (MEM_COMMIT - 1);
+	if (step > (size_t) (mem_max_addr - mem_committed))
+	    step = mem_max_addr - mem_committed;
+	if (mprotect(mem_committed, step, PROT_READ | PROT_WRITE) != 0)
+	    ok = false;
+	else
+	    mem_committed += step;
     }
+#endif
     if (ok) {
+	/* Memory above the highest break so far is still zero-filled from mmap */
+	mem_last_fresh = (old_brk >= mem_max_brk);
 	mem_brk += incr;
+	if (mem_brk > mem_max_brk)
+	    mem_max_brk = mem_brk;
 	return (void *) old_brk;
     } else {
 	errno = ENOMEM;
@@ -85,6 +128,16 @@ void *mem_sbrk(intptr_t incr) {
     }
 }
 
+/*
+ * mem_sbrk_fresh - returns true if the area handed out by the most recent
+ *		successful mem_sbrk call had never been part of the heap before.
+ *		Such memory comes straight from the anonymous mapping and is
+ *		therefore zero-filled.  Areas reused after mem_reset_brk are not.
+ */
+bool mem_sbrk_fresh(void) {
+    return mem_last_fresh;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -136,8 +189,8 @@ void mem_write(void *addr, uint64_t val, size_t len) {
         memcpy(addr, (void *) &val, len);
 }
 
-/* Emulation of memcpy */
-void *mem_memcpy(void *dst, const void *src, size_t n) {
+/* Word-at-a-time emulation of memcpy (reference version) */
+void *mem_memcpy_words(void *dst, const void *src, size_t n) {
     void *savedst = dst;
     size_t w = sizeof(uint64_t);
     while (n >= w) {
@@ -154,8 +207,8 @@ void *mem_memcpy(void *dst, const void *src, size_t n) {
     return savedst;
 }
 
-/* Emulation of memset */
-void *mem_memset(void *dst, int c, size_t n) {
+/* Word-at-a-time emulation of memset (reference version) */
+void *mem_memset_words(void *dst, int c, size_t n) {
     void *savedst = dst;
     uint64_t byte = c & 0xFF;
     uint64_t data = 0;
@@ -175,6 +228,233 @@ void *mem_memset(void *dst, int c, size_t n) {
     return savedst;
 }
 
+#if defined(__x86_64__)
+/*
+ * Vector versions.  Blocks shorter than one vector are moved with
+ * overlapping scalar accesses.  Longer ones store an unaligned first
+ * vector, then aligned vectors from the next dst boundary on, and
+ * finish with an unaligned (overlapping) last vector.  Copies of at
+ * least MEM_NT_BYTES bypass the cache with non-temporal stores.
+ */
+
+/* -1: not yet probed, 0: SSE2 only, 1: AVX2 */
+static int mem_use_avx2 = -1;
+
+static inline void mem_small_copy(unsigned char *d, const unsigned char *s, size_t n) {
+    if (n >= 8) {
+	uint64_t a, b;
+	__builtin_memcpy(&a, s, 8);
+	__builtin_memcpy(&b, s + n - 8, 8);
+	__builtin_memcpy(d, &a, 8);
+	__builtin_memcpy(d + n - 8, &b, 8);
+    } else if (n >= 4) {
+	uint32_t a, b;
+	__builtin_memcpy(&a, s, 4);
+	__builtin_memcpy(&b, s + n - 4, 4);
+	__builtin_memcpy(d, &a, 4);
+	__builtin_memcpy(d + n - 4, &b, 4);
+    } else {
+	while (n--)
+	    *d++ = *s++;
+    }
+}
+
+static inline void mem_small_set(unsigned char *d, uint64_t data, size_t n) {
+    if (n >= 8) {
+	__builtin_memcpy(d, &data, 8);
+	__builtin_memcpy(d + n - 8, &data, 8);
+    } else if (n >= 4) {
+	__builtin_memcpy(d, &data, 4);
+	__builtin_memcpy(d + n - 4, &data, 4);
+    } else {
+	while (n--)
+	    *d++ = (unsigned char) data;
+    }
+}
+
+static void mem_copy_sse2(unsigned char *d, const unsigned char *s, size_t n) {
+    unsigned char *dend = d + n;
+    const unsigned char *send = s + n;
+    __m128i last = _mm_loadu_si128((const __m128i *) (send - 16));
+    _mm_storeu_si128((__m128i *) d, _mm_loadu_si128((const __m128i *) s));
+    size_t skew = 16 - ((uintptr_t) d & 15);
+    d += skew;
+    s += skew;
+    n -= skew;
+    if (n >= MEM_NT_BYTES) {
+	for (; n > 64; n -= 64, d += 64, s += 64) {
+	    __m128i x0 = _mm_loadu_si128((const __m128i *) s);
+	    __m128i x1 = _mm_loadu_si128((const __m128i *) (s + 16));
+	    __m128i x2 = _mm_loadu_si128((const __m128i *) (s + 32));
+	    __m128i x3 = _mm_loadu_si128((const __m128i *) (s + 48));
+	    _mm_stream_si128((__m128i *) d, x0);
+	    _mm_stream_si128((__m128i *) (d + 16), x1);
+	    _mm_stream_si128((__m128i *) (d + 32), x2);
+	    _mm_stream_si128((__m128i *) (d + 48), x3);
+	}
+	_mm_sfence();
+    } else {
+	for (; n > 64; n -= 64, d += 64, s += 64) {
+	    __m128i x0 = _mm_loadu_si128((const __m128i *) s);
+	    __m128i x1 = _mm_loadu_si128((const __m128i *) (s + 16));
+	    __m128i x2 = _mm_loadu_si128((const __m128i *) (s + 32));
+	    __m128i x3 = _mm_loadu_si128((const __m128i *) (s + 48));
+	    _mm_store_si128((__m128i *) d, x0);
+	    _mm_store_si128((__m128i *) (d + 16), x1);
+	    _mm_store_si128((__m128i *) (d + 32), x2);
+	    _mm_store_si128((__m128i *) (d + 48), x3);
+	}
+    }
+    for (; n > 16; n -= 16, d += 16, s += 16)
+	_mm_store_si128((__m128i *) d, _mm_loadu_si128((const __m128i *) s));
+    _mm_storeu_si128((__m128i *) (dend - 16), last);
+}
+
+__attribute__((target("avx2")))
+static void mem_copy_avx2(unsigned char *d, const unsigned char *s, size_t n) {
+    unsigned char *dend = d + n;
+    const unsigned char *send = s + n;
+    __m256i last = _mm256_loadu_si256((const __m256i *) (send - 32));
+    _mm256_storeu_si256((__m256i *) d, _mm256_loadu_si256((const __m256i *) s));
+    size_t skew = 32 - ((uintptr_t) d & 31);
+    d += skew;
+    s += skew;
+    n -= skew;
+    if (n >= MEM_NT_BYTES) {
+	for (; n > 128; n -= 128, d += 128, s += 128) {
+	    __m256i y0 = _mm256_loadu_si256((const __m256i *) s);
+	    __m256i y1 = _mm256_loadu_si256((const __m256i *) (s + 32));
+	    __m256i y2 = _mm256_loadu_si256((const __m256i *) (s + 64));
+	    __m256i y3 = _mm256_loadu_si256((const __m256i *) (s + 96));
+	    _mm256_stream_si256((__m256i *) d, y0);
+	    _mm256_stream_si256((__m256i *) (d + 32), y1);
+	    _mm256_stream_si256((__m256i *) (d + 64), y2);
+	    _mm256_stream_si256((__m256i *) (d + 96), y3);
+	}
+	_mm_sfence();
+    } else {
+	for (; n > 128; n -= 128, d += 128, s += 128) {
+	    __m256i y0 = _mm256_loadu_si256((const __m256i *) s);
+	    __m256i y1 = _mm256_loadu_si256((const __m256i *) (s + 32));
+	    __m256i y2 = _mm256_loadu_si256((const __m256i *) (s + 64));
+	    __m256i y3 = _mm256_loadu_si256((const __m256i *) (s + 96));
+	    _mm256_store_si256((__m256i *) d, y0);
+	    _mm256_store_si256((__m256i *) (d + 32), y1);
+	    _mm256_store_si256((__m256i *) (d + 64), y2);
+	    _mm256_store_si256((__m256i *) (d + 96), y3);
+	}
+    }
+    for (; n > 32; n -= 32, d += 32, s += 32)
+	_mm256_store_si256((__m256i *) d, _mm256_loadu_si256((const __m256i *) s));
+    _mm256_storeu_si256((__m256i *) (dend - 32), last);
+    _mm256_zeroupper();
+}
+
+static void mem_set_sse2(unsigned char *d, int c, size_t n) {
+    unsigned char *dend = d + n;
+    __m128i x = _mm_set1_epi8((char) c);
+    _mm_storeu_si128((__m128i *) d, x);
+    size_t skew = 16 - ((uintptr_t) d & 15);
+    d += skew;
+    n -= skew;
+    if (n >= MEM_NT_BYTES) {
+	for (; n > 64; n -= 64, d += 64) {
+	    _mm_stream_si128((__m128i *) d, x);
+	    _mm_stream_si128((__m128i *) (d + 16), x);
+	    _mm_stream_si128((__m128i *) (d + 32), x);
+	    _mm_stream_si128((__m128i *) (d + 48), x);
+	}
+	_mm_sfence();
+    } else {
+	for (; n > 64; n -= 64, d += 64) {
+	    _mm_store_si128((__m128i *) d, x);
+	    _mm_store_si128((__m128i *) (d + 16), x);
+	    _mm_store_si128((__m128i *) (d + 32), x);
+	    _mm_store_si128((__m128i *) (d + 48), x);
+	}
+    }
+    for (; n > 16; n -= 16, d += 16)
+	_mm_store_si128((__m128i *) d, x);
+    _mm_storeu_si128((__m128i *) (dend - 16), x);
+}
+
+__attribute__((target("avx2")))
+static void mem_set_avx2(unsigned char *d, int c, size_t n) {
+    unsigned char *dend = d + n;
+    __m256i y = _mm256_set1_epi8((char) c);
+    _mm256_storeu_si256((__m256i *) d, y);
+    size_t skew = 32 - ((uintptr_t) d & 31);
+    d += skew;
+    n -= skew;
+    if (n >= MEM_NT_BYTES) {
+	for (; n > 128; n -= 128, d += 128) {
+	    _mm256_stream_si256((__m256i *) d, y);
+	    _mm256_stream_si256((__m256i *) (d + 32), y);
+	    _mm256_stream_si256((__m256i *) (d + 64), y);
+	    _mm256_stream_si256((__m256i *) (d + 96), y);
+	}
+	_mm_sfence();
+    } else {
+	for (; n > 128; n -= 128, d += 128) {
+	    _mm256_store_si256((__m256i *) d, y);
+	    _mm256_store_si256((__m256i *) (d + 32), y);
+	    _mm256_store_si256((__m256i *) (d + 64), y);
+	    _mm256_store_si256((__m256i *) (d + 96), y);
+	}
+    }
+    for (; n > 32; n -= 32, d += 32)
+	_mm256_store_si256((__m256i *) d, y);
+    _mm256_storeu_si256((__m256i *) (dend - 32), y);
+    _mm256_zeroupper();
+}
+
+static inline bool mem_avx2(void) {
+    if (mem_use_avx2 < 0) {
+	__builtin_cpu_init();
+	mem_use_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return mem_use_avx2;
+}
+
+/* Emulation of memcpy */
+void *mem_memcpy(void *dst, const void *src, size_t n) {
+    unsigned char *d = dst;
+    const unsigned char *s = src;
+    if (n < 16)
+	mem_small_copy(d, s, n);
+    else if (n >= 32 && mem_avx2())
+	mem_copy_avx2(d, s, n);
+    else
+	mem_copy_sse2(d, s, n);
+    return dst;
+}
+
+/* Emulation of memset */
+void *mem_memset(void *dst, int c, size_t n) {
+    unsigned char *d = dst;
+    if (n < 16)
+	mem_small_set(d, 0x0101010101010101ull * (unsigned char) c, n);
+    else if (n >= 32 && mem_avx2())
+	mem_set_avx2(d, c, n);
+    else
+	mem_set_sse2(d, c, n);
+    return dst;
+}
+
+#else /* !__x86_64__ */
+
+/* Emulation of memcpy */
+void *mem_memcpy(void *dst, const void *src, size_t n) {
+    return mem_memcpy_words(dst, src, n);
+}
+
+/* Emulation of memset */
+void *mem_memset(void *dst, int c, size_t n) {
+    return mem_memset_words(dst, c, n);
+}
+
+#endif /* __x86_64__ */
+
 /* Function to aid in viewing contents of heap */
 void hprobe(void *ptr, int offset, size_t count) {
     unsigned char *cptr = (unsigned char *) ptr;
@@ -5,6 +5,7 @@
 void mem_init();               
 void mem_deinit(void);
 void *mem_sbrk(intptr_t incr);
+bool mem_sbrk_fresh(void);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
@@ -27,5 +28,9 @@ void *mem_memcpy(void *dst, const void *src, size_t n);
 /* Emulation of memset */
 void *mem_memset(void *dst, int c, size_t n);
 
+/* Word-at-a-time reference versions of the above (for benchmarking) */
+void *mem_memcpy_words(void *dst, const void *src, size_t n);
+void *mem_memset_words(void *dst, int c, size_t n);
+
 /* Debugging function to view region of heap */
 void hprobe(void *ptr, int offset, size_t count);
@@ -0,0 +1,348 @@
+/*
+ * mkclasses.c - Generate the size-class table of mm.c from trace files
+ *
+ * Reads .rep traces, builds a histogram of the block sizes mm.c will
+ * request (payload plus header and footer, rounded to ALIGNMENT) and
+ * of object lifetimes (operations between allocation and free), and
+ * writes a header in the format of mm_classes.h.  Sizes that make up
+ * a large share of all requests get a class of their own, the rest of
+ * the range is covered by power-of-two classes.  Requests freed again
+ * within SHORT_LIFE ops count twice in that share: blocks that churn
+ * gain most from a class where any block fits at once, while a size
+ * allocated once and kept searches its class only once.
+ *
+ * Usage: mkclasses [-h] [-d] [-n <classes>] [-p <percent>] [-o <file>] [trace ...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+/* Block sizes up to LUT_MAX bytes are mapped through a lookup table */
+#define LUT_MAX 4096
+/* Largest table size supported by mm.c (class indices are bytes) */
+#define MAX_CLASSES 64
+/* Exact-size histogram covers block sizes up to this many bytes */
+#define HIST_MAX (1<<20)
+/* Lifetimes are bucketed by powers of two up to 2^LIFE_BUCKETS ops */
+#define LIFE_BUCKETS 32
+/* Lifetime in ops below which a request counts twice for a hot size */
+#define SHORT_LIFE 1024
+/* Number of hot sizes listed in the report */
+#define REPORT_SIZES 10
+
+/* Requests and summed lifetimes per block size / ALIGNMENT */
+static unsigned long size_count[HIST_MAX / ALIGNMENT + 1];
+static unsigned long size_life_count[HIST_MAX / ALIGNMENT + 1];
+static double size_life_sum[HIST_MAX / ALIGNMENT + 1];
+/* Requests per block size / ALIGNMENT freed within SHORT_LIFE ops */
+static unsigned long size_short_count[HIST_MAX / ALIGNMENT + 1];
+static unsigned long short_count;
+static unsigned long large_count;   /* requests above HIST_MAX */
+static unsigned long total_count;
+static unsigned long life_hist[LIFE_BUCKETS + 1];
+static unsigned long live_at_end;
+
+/* Class limits: class i holds block sizes in (limit[i-1], limit[i]] */
+static size_t limits[MAX_CLASSES];
+static int num_limits;
+
+static void app_error(const char *msg, const char *arg) {
+    fprintf(stderr, "mkclasses: %s%s%s\n", msg, arg ? " " : "", arg ? arg : "");
+    exit(1);
+}
+
+/* Block size mm.c uses for a request of 'size' payload bytes */
+static size_t block_size(size_t size) {
+    size_t asize = (size + 2 * sizeof(size_t) + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+    return asize < 2 * ALIGNMENT ? 2 * ALIGNMENT : asize;
+}
+
+static int log2_bucket(unsigned long v) {
+    int b = 0;
+    while (v > 1 && b < LIFE_BUCKETS) {
+        v >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void record_alloc(size_t bsize) {
+    total_count++;
+    if (bsize <= HIST_MAX)
+        size_count[bsize / ALIGNMENT]++;
+    else
+        large_count++;
+}
+
+static void record_free(size_t bsize, unsigned long life) {
+    life_hist[log2_bucket(life)]++;
+    if (bsize <= HIST_MAX) {
+        size_life_count[bsize / ALIGNMENT]++;
+        size_life_sum[bsize / ALIGNMENT] += life;
+    }
+    if (life < SHORT_LIFE) {
+        short_count++;
+        if (bsize <= HIST_MAX)
+            size_short_count[bsize / ALIGNMENT]++;
+    }
+}
+
+/* Weight of size index i when choosing hot sizes, see the top */
+static unsigned long hot_weight(int i) {
+    return size_count[i] + size_short_count[i];
+}
+
+/*
+ * read_trace - add the requests of one .rep file to the histograms
+ */
+static void read_trace(const char *filename) {
+    FILE *f;
+    int weight, num_ids, num_ops;
+    size_t data_bytes;
+    char type[2];
+    int index;
+    size_t size;
+    unsigned long op;
+
+    if ((f = fopen(filename, "r")) == NULL)
+        app_error("could not open", filename);
+    if (fscanf(f, "%d %d %d %zu", &weight, &num_ids, &num_ops, &data_bytes) != 4)
+        app_error("bad header in", filename);
+
+    size_t *sizes = calloc(num_ids, sizeof(size_t));
+    unsigned long *born = calloc(num_ids, sizeof(unsigned long));
+    if (!sizes || !born)
+        app_error("out of memory reading", filename);
+
+    for (op = 0; op < (unsigned long) num_ops && fscanf(f, "%1s", type) == 1; op++) {
+        switch (type[0]) {
+            case 'a':
+            case 'r':
+                if (fscanf(f, "%d %zu", &index, &size) != 2 || index < 0 || index >= num_ids)
+                    app_error("bad request in", filename);
+                if (type[0] == 'r' && sizes[index])
+                    record_free(sizes[index], op - born[index]);
+                sizes[index] = block_size(size);
+                born[index] = op;
+                record_alloc(sizes[index]);
+                break;
+            case 'f':
+                if (fscanf(f, "%d", &index) != 1 || index >= num_ids)
+                    app_error("bad request in", filename);
+                if (index >= 0 && sizes[index]) {
+                    record_free(sizes[index], op - born[index]);
+                    sizes[index] = 0;
+                }
+                break;
+            default:
+                app_error("bad request type in", filename);
+        }
+    }
+    for (index = 0; index < num_ids; index++)
+        if (sizes[index])
+            live_at_end++;
+    free(sizes);
+    free(born);
+    fclose(f);
+}
+
+static int cmp_size(const void *a, const void *b) {
+    size_t x = *(const size_t *) a, y = *(const size_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void add_limit(size_t limit) {
+    int i;
+    for (i = 0; i < num_limits; i++)
+        if (limits[i] == limit)
+            return;
+    if (num_limits < MAX_CLASSES)
+        limits[num_limits++] = limit;
+}
+
+/*
+ * make_classes - hot sizes (by hot_weight) get an exact class (limits
+ * size-ALIGNMENT and size); power-of-two limits fill the remaining
+ * slots from the small end.  The last class takes everything larger.
+ */
+static void make_classes(int nclasses, double hot_pct, size_t *hot, int *nhot) {
+    int i, k;
+    *nhot = 0;
+    num_limits = 0;
+
+    while (*nhot < nclasses / 2) {
+        size_t best = 0;
+        for (i = 2; i <= HIST_MAX / ALIGNMENT; i++) {
+            bool taken = false;
+            for (k = 0; k < *nhot; k++)
+                taken |= (hot[k] == (size_t) i * ALIGNMENT);
+            if (!taken && (best == 0 || hot_weight(i) > hot_weight(best / ALIGNMENT)))
+                best = (size_t) i * ALIGNMENT;
+        }
+        if (best == 0 || total_count == 0 ||
+            100.0 * hot_weight(best / ALIGNMENT) / (total_count + short_count) < hot_pct)
+            break;
+        hot[(*nhot)++] = best;
+    }
+    for (k = 0; k < *nhot; k++) {
+        add_limit(hot[k] - 1);
+        add_limit(hot[k]);
+    }
+    for (k = 6; num_limits < nclasses - 1 && k < 63; k++)
+        add_limit(((size_t) 1 << k) - 1);
+    qsort(limits, num_limits, sizeof(size_t), cmp_size);
+    while (num_limits > nclasses - 1)
+        num_limits--;
+    limits[num_limits++] = SIZE_MAX;
+}
+
+/* make_default_classes - power-of-two classes as mm.c always had them */
+static void make_default_classes(int nclasses) {
+    int k;
+    num_limits = 0;
+    for (k = 0; k < nclasses - 1; k++)
+        limits[num_limits++] = ((size_t) 2 << k) - 1;
+    limits[num_limits++] = SIZE_MAX;
+}
+
+static int class_of(size_t size) {
+    int i;
+    for (i = 0; i < num_limits - 1 && size > limits[i]; i++)
+        ;
+    return i;
+}
+
+static void write_header(FILE *out, int argc, char **argv, int first,
+                         int nhot, bool deflt) {
+    int i, k;
+
+    fprintf(out, "/*\n * mm_classes.h - size classes of the mm.c seg lists\n *\n");
+    if (deflt) {
+        fprintf(out, " * Power-of-two classes: class k holds blocks of [2^k, 2^(k+1)) bytes.\n");
+    } else {
+        fprintf(out, " * Profile-guided classes generated from:\n");
+        for (i = first; i < argc; i++)
+            fprintf(out, " *   %s\n", argv[i]);
+        fprintf(out, " * %lu requests, %lu still live at the end of their trace.\n",
+                total_count, live_at_end);
+        fprintf(out, " *\n * Most frequent block sizes (share of requests, mean lifetime in ops):\n");
+        size_t *order = calloc(HIST_MAX / ALIGNMENT + 1, sizeof(size_t));
+        for (k = 0; k < REPORT_SIZES; k++) {
+            size_t best = 0;
+            for (i = 2; i <= HIST_MAX / ALIGNMENT; i++)
+                if (!order[i] && (best == 0 || size_count[i] > size_count[best]))
+                    best = i;
+            if (best == 0 || size_count[best] == 0)
+                break;
+            order[best] = 1;
+            fprintf(out, " *   %7zu bytes %6.2f%% %12.0f%s\n", best * ALIGNMENT,
+                    100.0 * size_count[best] / total_count,
+                    size_life_count[best] ? size_life_sum[best] / size_life_count[best] : 0.0,
+                    (nhot > 0 && class_of(best * ALIGNMENT) > 0 &&
+                     limits[class_of(best * ALIGNMENT) - 1] == best * ALIGNMENT - 1 &&
+                     limits[class_of(best * ALIGNMENT)] == best * ALIGNMENT) ? "  (own class)" : "");
+        }
+        free(order);
+        if (large_count)
+            fprintf(out, " *   %lu requests above %d bytes\n", large_count, HIST_MAX);
+        fprintf(out, " *\n * Lifetimes (ops between allocation and free); requests freed within\n"
+                " * %d ops count twice when choosing the sizes with a class of their own:\n",
+                SHORT_LIFE);
+        for (i = 0; i <= LIFE_BUCKETS; i++)
+            if (life_hist[i])
+                fprintf(out, " *   < 2^%-2d %10lu\n", i + 1, life_hist[i]);
+    }
+    fprintf(out, " *\n * Generated by mkclasses; do not edit.\n */\n");
+    fprintf(out, "#ifndef MM_CLASSES_H_\n#define MM_CLASSES_H_\n\n");
+    fprintf(out, "#define SEGLIST_SIZE %d\n\n", num_limits);
+    fprintf(out, "/* Block sizes up to CLASS_LUT_MAX bytes: class is class_lut[size / 16] */\n");
+    fprintf(out, "#define CLASS_LUT_MAX %d\n\n", LUT_MAX);
+    fprintf(out, "static const unsigned char class_lut[CLASS_LUT_MAX / 16 + 1] = {");
+    for (i = 0; i <= LUT_MAX / ALIGNMENT; i++)
+        fprintf(out, "%s%2d,", (i % 16) ? " " : "\n    ", class_of((size_t) i * ALIGNMENT));
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "/* Class i holds block sizes in (class_limit[i-1], class_limit[i]] */\n");
+    fprintf(out, "static const size_t class_limit[SEGLIST_SIZE] = {");
+    for (i = 0; i < num_limits; i++) {
+        if (limits[i] == SIZE_MAX)
+            fprintf(out, "%sSIZE_MAX", (i % 4) ? " " : "\n    ");
+        else
+            fprintf(out, "%s%zu,", (i % 4) ? " " : "\n    ", limits[i]);
+    }
+    fprintf(out, "\n};\n\n#endif /* MM_CLASSES_H_ */\n");
+}
+
+static void usage(char *prog) {
+    fprintf(stderr, "Usage: %s [-h] [-d] [-n <classes>] [-p <percent>] [-o <file>] [trace ...]\n", prog);
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-d           Write the default power-of-two table (no traces).\n");
+    fprintf(stderr, "\t-h           Print this message.\n");
+    fprintf(stderr, "\t-n <classes> Number of size classes (default 20, max %d).\n", MAX_CLASSES);
+    fprintf(stderr, "\t-o <file>    Write the header to <file> instead of stdout.\n");
+    fprintf(stderr, "\t-p <percent> Share of requests that makes a size hot, short-lived ones\n"
+                    "\t             counted twice (default 2).\n");
+}
+
+int main(int argc, char **argv) {
+    int c, i;
+    int nclasses = 20;
+    double hot_pct = 2.0;
+    bool deflt = false;
+    char *outname = NULL;
+    size_t hot[MAX_CLASSES];
+    int nhot = 0;
+    FILE *out = stdout;
+
+    while ((c = getopt(argc, argv, "dhn:o:p:")) != EOF) {
+        switch (c) {
+            case 'd':
+                deflt = true;
+                break;
+            case 'n':
+                nclasses = atoi(optarg);
+                break;
+            case 'o':
+                outname = optarg;
+                break;
+            case 'p':
+                hot_pct = atof(optarg);
+                break;
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+    if (nclasses < 2 || nclasses > MAX_CLASSES)
+        app_error("number of classes out of range", NULL);
+    if (!deflt && optind == argc)
+        app_error("no trace files given (use -d for the default table)", NULL);
+
+    if (deflt) {
+        make_default_classes(nclasses);
+    } else {
+        for (i = optind; i < argc; i++)
+            read_trace(argv[i]);
+        make_classes(nclasses, hot_pct, hot, &nhot);
+    }
+
+    if (outname && (out = fopen(outname, "w")) == NULL)
+        app_error("could not create", outname);
+    write_header(out, argc, argv, optind, nhot, deflt);
+    if (outname)
+        fclose(out);
+
+    if (!deflt) {
+        fprintf(stderr, "%d classes, %d hot sizes:", num_limits, nhot);
+        for (i = 0; i < nhot; i++)
+            fprintf(stderr, " %zu", hot[i]);
+        fprintf(stderr, "\n");
+    }
+    return 0;
+}
@@ -14,9 +14,22 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
 
 #include "mm.h"
 #include "memlib.h"
+#ifdef MM_SIDE_META
+#include <sys/mman.h>
+#endif
+/* Size classes of the seg lists; a profile-guided table generated by
+ * mkclasses can be built in with -DMM_CLASSES='"mm_classes_gen.h"' */
+#ifdef MM_CLASSES
+#include MM_CLASSES
+#else
+#include "mm_classes.h"
+#endif
 
 /* If you want debugging output, use the following macro.  When you hand
  * in, remove the #define DEBUG line. */
@@ -44,6 +57,18 @@
 #define memcpy mem_memcpy
 #endif /* def DRIVER */
 
+// The aligned and introspection entry points of the shared library
+// build (libmm.so) get the same treatment
+#ifdef DRIVER
+#define memalign mm_memalign
+#define posix_memalign mm_posix_memalign
+#define aligned_alloc mm_aligned_alloc
+#define valloc mm_valloc
+#define pvalloc mm_pvalloc
+#define reallocarray mm_reallocarray
+#define malloc_usable_size mm_malloc_usable_size
+#endif /* def DRIVER */
+
 #define ALIGNMENT 16
 
 // citation: csapp textbook;
@@ -52,9 +77,76 @@
 #define CHUNK (1<<12)
 
 #define INITIALCHUNK (1<<6)
-#define SEGLIST_SIZE 20
 #define REALLOC_BUF (1<<7)    
 
+// Smallest free block that can carry a known-zero offset (3rd payload word)
+#define ZERO_MINBLOCK 48
+// Free-list links and the offset word itself are never zero
+#define ZERO_MINOFF (3*WORDSIZE)
+
+// Quick lists: exact sizes of up to QUICK_GRANULES*ALIGNMENT bytes
+#define QUICK_GRANULES 32
+// Frees between two updates of the hot sizes
+#define QUICK_WINDOW 1024
+// A size is hot if it made up at least 1/QUICK_HOT_SHARE of a window's frees
+#define QUICK_HOT_SHARE 16
+
+// Seg lists of the short-lived region (MM_HINT_SHORT) follow those of the
+// default region; the short region grows by at least SHORT_CHUNK bytes.
+// A free block coalesces only with free neighbours of its own region, so
+// the chunks of the two regions stay apart.
+#define REGIONS 2
+#define SHORT_CHUNK CHUNK
+
+// Largest pending buffer of deferred frees (MM_CFG_DEFER)
+#define DEFER_MAX 1024
+
+// Ancestors kept by an address-ordered seg list walk (expected treap depth
+// is about 2 ln n, so this covers any heap that fits in memory)
+#define TREE_STACK 128
+
+// Farthest a seg list walk prefetches ahead, in blocks (MM_CFG_PREFETCH)
+#define PREFETCH_MAX 2
+
+// Cache-line size assumed by MM_FLAG_CACHELINE and MM_CFG_THREAD_LINES
+#define CACHELINE 64
+
+// Environment variable read by the first mm_init/mm_config call
+#define CONFIG_ENV "MM_CONFIG"
+
+// MM_CFG_LOCK is on by default in the shared library: a preloaded
+// allocator can't know whether the program starts threads
+#ifdef DRIVER
+#define LOCK_DEFAULT 0
+#else
+#define LOCK_DEFAULT 1
+#endif
+
+// Metadata layout.  By default the header, footer, list links and
+// zero offset of a block are words of the heap itself, around and at
+// the start of its payload.  Built with -DMM_SIDE_META they move to a
+// side table with one 32-bit slot per heap word instead: the words of
+// the heap stay where they are but are never read or written by the
+// allocator, list links are granule indices, a seg list search reads
+// half as many bytes, and a buffer overrun can't corrupt the heap's
+// structure.  A size of 4GB or more doesn't fit a slot: the slot then
+// holds SIDE_WIDE and the value goes to the heap word after all.
+// Granule-index links limit the heap to SIDE_MAX_HEAP bytes.
+#ifdef MM_SIDE_META
+#define SIDE_MAX_HEAP (1ul << 36)
+#define SIDE_WIDE 0xffffffffu
+typedef uint32_t meta_t;          // a header, footer or zero offset
+typedef uint32_t link_t;          // a list link: payload granule index, 0 for NULL
+#else
+typedef size_t meta_t;
+typedef void *link_t;
+#endif
+
+#ifdef MM_SIDE_META
+static meta_t *side_meta;          // slot i holds the metadata word at meta_base + i*WORDSIZE
+static char *meta_base;            // start of the heap
+#endif
+
 ////
 //// Static functions - Declarations
 ////
@@ -69,9 +161,29 @@ return ((x) < (y) ? (x) : (y));
 }
 
 
-// Get a word from address p
+// Where the metadata word of heap address p lives (see MM_SIDE_META)
+static inline void *meta_addr(void *p){
+#ifdef MM_SIDE_META
+return (side_meta + ((char *)(p) - meta_base) / WORDSIZE);
+#else
+return (p);
+#endif
+}
+
+#ifdef MM_SIDE_META
+// The heap word whose metadata slot is p, for SIDE_WIDE values
+static inline size_t *wide_word(void *p){
+return (size_t *)(meta_base + ((meta_t *)(p) - side_meta) * WORDSIZE);
+}
+#endif
+
+// Get a word from (metadata) address p
 static inline size_t read_word(void *p){
-return (*(size_t *)(p));
+#ifdef MM_SIDE_META
+if (*(meta_t *)(p) == SIDE_WIDE)
+    return *wide_word(p);
+#endif
+return (*(meta_t *)(p));
 }
 
 // Reallocation tag for free block
@@ -79,14 +191,25 @@ static inline size_t read_tag(void *p){
 return (read_word(p) & 0x2);
 }
 
-// Put a word at address p
-static inline void write_word(void *p, size_t val){
-(*(size_t *)(p) = (val) | read_tag(p));
+// Short-lived region tag of a block header (set when the block is created)
+static inline size_t read_region_tag(void *p){
+return (read_word(p) & 0x8);
 }
 
 // Write value without tag
 static inline void write_no_tag(void *p, size_t val){
-(*(size_t *)(p) = (val));
+#ifdef MM_SIDE_META
+if (val >= SIDE_WIDE) {
+    *wide_word(p) = val;
+    val = SIDE_WIDE;
+}
+#endif
+(*(meta_t *)(p) = (val));
+}
+
+// Put a word at address p
+static inline void write_word(void *p, size_t val){
+write_no_tag(p, (val) | read_tag(p) | read_region_tag(p));
 }
 
 //set an allocated bit alongwith size into the word 
@@ -94,9 +217,22 @@ static inline size_t set_word(size_t size, size_t alloc){
 return ((size) | (alloc));
 }
 
-// Set previous and next pointers for a free block
+// Set previous and next pointers for a free block (p is a list link)
 static inline void set_pointer(void *p, void *ptr){
-(*(size_t *)(p) = (size_t)(ptr));
+#ifdef MM_SIDE_META
+(*(link_t *)(p) = (ptr) ? ((char *)(ptr) - meta_base) / ALIGNMENT : 0);
+#else
+(*(link_t *)(p) = (ptr));
+#endif
+}
+
+// Get the block a list link points to
+static inline void* read_pointer(void *p){
+#ifdef MM_SIDE_META
+return (*(link_t *)(p) ? meta_base + (size_t) *(link_t *)(p) * ALIGNMENT : NULL);
+#else
+return (*(link_t *)(p));
+#endif
 }
 
 // Get the size from address p  
@@ -112,51 +248,102 @@ return (read_word(p) & 0x1);
 // Set and Remove reallocation tag 
 static inline void set_realloc_tag(void *p){
 size_t x = read_word((void *)p);
-x=x|0x2; *(size_t *)p=x;
+x=x|0x2; write_no_tag(p, x);
 }
 
 static inline void del_realloc_tag(void *p){
 size_t x = read_word((void *)p);
-x=x&~0x2; *(size_t *)p=x;
+x=x&~0x2; write_no_tag(p, x);
 } 
 
+// Known-zero tag for free block header (cleared by every header rewrite)
+static inline size_t read_zero_tag(void *p){
+return (read_word(p) & 0x4);
+}
+
 // Get address of a block's header and footer
 static inline void* header_ptr(void *ptr){
-return ((ptr) - WORDSIZE);
+return meta_addr((ptr) - WORDSIZE);
 }
 static inline void* footer_ptr(void *ptr){
-return ((ptr) + fetch_size(header_ptr(ptr)) - DOUBLESIZE);  
+return meta_addr((ptr) + fetch_size(header_ptr(ptr)) - DOUBLESIZE);  
 }
 
 // Get address of previous and next blocks 
 static inline void* next_blockptr(void *ptr){
-return ((ptr) + fetch_size((ptr) - WORDSIZE));
+return ((ptr) + fetch_size(header_ptr(ptr)));
 }
 static inline void* prev_blockptr(void *ptr){
-return ((ptr) - fetch_size((ptr) - DOUBLESIZE));  
+return ((ptr) - fetch_size(meta_addr((ptr) - DOUBLESIZE)));  
 }
 
 // Get address of free block's predecessor and successor pointers 
 static inline void* get_pred_ptr(void *ptr){
-return ((ptr));
+return meta_addr((ptr));
 }
 static inline void* get_succ_ptr(void *ptr){
-return ((ptr) + WORDSIZE);
+return meta_addr((ptr) + WORDSIZE);
 }
 
 // Get address of free block's predecessor and successor
 static inline void* get_pred(void *ptr){
-return (*(void **)(ptr));
+return read_pointer(get_pred_ptr(ptr));
 }
 static inline void* get_succ(void *ptr){
-return (*(void **)((ptr) + WORDSIZE));
+return read_pointer(get_succ_ptr(ptr));
+}
+
+// Offset into a free block from where its payload is known to be zero-filled
+// (up to the footer); the block size if nothing is known
+static inline size_t zero_offset(void *ptr){
+    if (read_zero_tag(header_ptr(ptr)))
+        return read_word(meta_addr((ptr) + DOUBLESIZE));
+    return fetch_size(header_ptr(ptr));
+}
+
+// Record that a free block is zero-filled from offset 'off' up to its footer
+static inline void set_zero_offset(void *ptr, size_t off){
+    size_t size = fetch_size(header_ptr(ptr));
+    off = maximum(off, ZERO_MINOFF);
+    if ((size < ZERO_MINBLOCK) || (off >= size - DOUBLESIZE))
+        return;
+    write_no_tag(meta_addr((ptr) + DOUBLESIZE), off);
+    write_no_tag(header_ptr(ptr), read_word(header_ptr(ptr)) | 0x4);
+}
+
+// Treap priority of a free block in MM_ORDER_ADDRESS mode: a hash of its address
+static inline size_t tree_prio(void *ptr){
+    return ((size_t) ptr >> 4) * 0x9e3779b97f4a7c15ul;
+}
+
+// Start loading the header and links of a free block a seg list walk is
+// about to visit (the header is on the previous line for 64-aligned blocks)
+static inline void prefetch_node(void *ptr){
+    __builtin_prefetch(header_ptr(ptr));
+    __builtin_prefetch(ptr);
+}
+
+// Seg list of a block of 'size' bytes: table lookup for small blocks,
+// otherwise the first class whose limit is not below the size
+static inline int size_class(size_t size){
+    int lst;
+    if (size <= CLASS_LUT_MAX)
+        return class_lut[size / ALIGNMENT];
+    for (lst = class_lut[CLASS_LUT_MAX / ALIGNMENT]; size > class_limit[lst]; lst++)
+        ;
+    return lst;
+}
+
+// First seg list of a region (a region tag, 0 or 0x8)
+static inline int region_lists(size_t region){
+    return region ? SEGLIST_SIZE : 0;
 }
 
 ////
 //// HELPER functions - Declarations
 ////
 // Heap extension of 'size'
-static void *heap_extension(size_t size);
+static void *heap_extension(size_t size, size_t region);
 
 // Merge free blocks - the boundary tags 
 static void *block_coalescing(void *ptr);
@@ -170,6 +357,28 @@ static void node_insert(void *ptr, size_t size);
 // Deletion of node
 static void node_del(void *ptr);
 
+// Search the seg lists of a region for a free block of adj_size bytes
+static void *find_fit(size_t adj_size, size_t region);
+
+// Allocate a block of 'size' payload bytes in a region
+static void *block_alloc(size_t size, size_t region);
+
+// Return an allocated block to the seg lists and coalesce it
+static void block_release(void *ptr);
+
+// Allocate 'size' payload bytes at an 'align'-aligned address in a region
+static void *block_alloc_aligned(size_t size, size_t align, size_t region);
+
+// Return the blocks of one quick list / of all quick lists to the seg lists
+static void quick_flush(size_t gran);
+static void quick_flush_all(void);
+
+// Release the deferred frees in one address-ordered pass
+static void pending_flush(void);
+
+// Release the blocks of the inline fast path's bins (mm_inline.h)
+static size_t inline_flush(void);
+
 ////
 //// Declarations of given functions
 ////
@@ -178,7 +387,64 @@ static bool aligned(const void* p);
 
 //// Global Variables
 static char *heap_ptr;             // pointer to first-block in heap 
-void *seg_freelist[SEGLIST_SIZE];    // pointer to seg-lists of diff lengths 
+link_t seg_freelist[REGIONS * SEGLIST_SIZE];    // pointer to seg-lists of diff lengths, per region
+static size_t place_dirty;         // leading payload bytes of last placed block that may be non-zero
+static void *seg_rover[REGIONS * SEGLIST_SIZE];  // next-fit roving pointer of each seg list
+
+// Quick lists of freed blocks of hot exact sizes, indexed by size/ALIGNMENT.
+// Their blocks stay marked allocated and are linked through the pred word.
+static void *quick_head[QUICK_GRANULES + 1];
+static unsigned quick_count[QUICK_GRANULES + 1];  // frees per size, decayed every window
+static bool quick_hot[QUICK_GRANULES + 1];
+static size_t quick_bytes;         // bytes held in all quick lists
+static unsigned quick_frees;       // frees in the current window
+
+// Deferred frees; like quick-listed blocks they stay marked allocated.
+// Those of up to QUICK_GRANULES granules are stacked per region and size,
+// linked through the pred word, larger ones are kept unsorted in pending[]
+static void *pending_head[REGIONS][QUICK_GRANULES + 1];
+static void *pending[DEFER_MAX];   // pending_flush sorts all of them here
+static size_t pending_large;       // deferred frees in pending[]
+static size_t pending_n;           // all deferred frees
+
+// Bins of the inline fast path in mm_inline.h, which pushes and pops
+// their blocks (allocated, linked through the first payload word) itself.
+// It takes no lock, so with conf.lock on every bin is kept closed: empty
+// and full, which sends both fast paths to the locked entry points.
+mm_inline_bin_t mm_inline_bins[MM_INLINE_BINS];
+
+//// Tuning parameters (see mm_config)
+typedef struct {
+    long order;         // free-list order (mm_order_t)
+    long fit;           // placement policy (mm_fit_t)
+    long split;         // split direction (mm_split_t)
+    long split_limit;   // MM_SPLIT_SIZE: blocks of this size or more are placed high
+    long good_n;        // MM_FIT_GOOD: candidates examined per seg list
+    long quick_bytes;   // bytes the quick lists may hold; 0 disables them
+    long defer;         // frees buffered before coalescing; 0 coalesces at once
+    long thread_lines;  // a thread's first malloc after another thread's gets its own lines
+    long prefetch;      // blocks a seg list walk prefetches ahead; 0 disables
+    long lock;          // public entry points serialize on heap_mutex
+} mm_conf_t;
+
+static mm_conf_t conf_next = { MM_ORDER_LIFO, MM_FIT_FIRST, MM_SPLIT_SIZE, 100, 4, 1<<16, 0, 0, 0, LOCK_DEFAULT };  // set by mm_config
+static mm_conf_t conf;            // in effect since the last mm_init
+static bool conf_env_done;        // CONFIG_ENV has been applied
+
+// MM_CFG_THREAD_LINES: the address of thread_tag identifies the calling
+// thread, last_thread is the thread of the last malloc
+static __thread char thread_tag;
+static const void *last_thread;
+
+// MM_CFG_LOCK: held by the public entry points while they run
+static pthread_mutex_t heap_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#ifndef DRIVER
+// Shared library: the heap is set up by the first call of any entry
+// point, under setup_mutex; heap_ready is set once it is usable
+static pthread_mutex_t setup_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool heap_ready;
+#endif
 
 /* rounds up to the nearest multiple of DSIZE */
 static size_t align(size_t x) {
@@ -188,8 +454,8 @@ return ALIGNMENT * ((x+ALIGNMENT-1)/ALIGNMENT);
 ////
 //// HELPER Functions - Definitions
 ////
-// Helper function: Heap extension with a free block required for allocation
-static void *heap_extension(size_t size) 
+// Helper function: Heap extension with a free block of 'region' required for allocation
+static void *heap_extension(size_t size, size_t region) 
 {
     void *ptr;                   
     size_t esize;
@@ -201,88 +467,222 @@ static void *heap_extension(size_t size)
 //*    esize = align(size);
     esize = (((size)+(ALIGNMENT-1)) & ~0xf);
 
+#ifdef MM_SIDE_META
+    if (esize > SIDE_MAX_HEAP - ((char *) mem_heap_hi() + 1 - meta_base))
+        return NULL;
+#endif
     if ((long) (ptr = mem_sbrk(esize)) == -1) {
         return NULL;
     }
+    bool fresh = mem_sbrk_fresh();
     
     // Citation: csapp textbook;
     // Header and footer of the new chunk of memory from heap extension
-    write_no_tag(header_ptr(ptr), set_word(esize, 0));  
-    write_no_tag(footer_ptr(ptr), set_word(esize, 0));    
+    write_no_tag(header_ptr(ptr), set_word(esize, 0) | region);  
+    write_no_tag(footer_ptr(ptr), set_word(esize, 0) | region);    
     // Next block should have size 0 and allocated bit=1 (epilogue block header)  
     write_no_tag(header_ptr(next_blockptr(ptr)), set_word(0, 1));
 
     // Insert the new block in the appropriate seg list
     node_insert(ptr, esize);
 
+    // Memory never handed out before is still zero past the list links
+    if (fresh)
+        set_zero_offset(ptr, ZERO_MINOFF);
+
     // Check for coalescing
     return block_coalescing(ptr);
 }
 
-// Helper function: Insertion of node
-static void node_insert(void *ptr, size_t size)
+// Helper functions: Address-ordered seg lists (MM_ORDER_ADDRESS)
+// Each seg list is a treap keyed by block address with tree_prio() as
+// heap priority; the pred and succ words of a free block hold its left
+// and right child.  There are no parent links: insertion and deletion
+// descend from the root through a 'link', the word that points to the
+// current subtree, and split or merge subtrees top-down without rotations.
+static void tree_insert(void *link, void *ptr)
 {
-    int lst = 0;
-    char *find_ptr = ptr;
-    char *insert_ptr = NULL;
-    
-    // Choose the seg list
-    while ((lst < SEGLIST_SIZE - 1) && (size > 1)){
-        size = size>>1;
-        lst++;
-    }
-    
-    // Continue asc. ordered search 
-    find_ptr = seg_freelist[lst];
-    while ((find_ptr != NULL) && (size > fetch_size(header_ptr(find_ptr)))){
-        insert_ptr = find_ptr;
-        find_ptr = get_pred(find_ptr);
-    }
-    
-    // Set predecessor and successor
-    if (find_ptr != NULL) {
-        if (insert_ptr != NULL){
-            // case 1: find pointer and insert pointer is not NULL 
-            set_pointer(get_pred_ptr(ptr), find_ptr);
-            set_pointer(get_succ_ptr(ptr), insert_ptr);
-            set_pointer(get_pred_ptr(insert_ptr), ptr);
-            set_pointer(get_succ_ptr(find_ptr), ptr);
-        } 
+    void *left = get_pred_ptr(ptr);
+    void *right = get_succ_ptr(ptr);
+    void *root;
+
+    // descend to where ptr's priority puts it
+    while (((root = read_pointer(link)) != NULL) && (tree_prio(root) > tree_prio(ptr)))
+        link = (ptr < root) ? get_pred_ptr(root) : get_succ_ptr(root);
+    set_pointer(link, ptr);
+
+    // split the subtree it replaces into blocks below and above ptr
+    while (root != NULL) {
+        if (root < ptr) {
+            set_pointer(left, root);
+            left = get_succ_ptr(root);
+            root = get_succ(root);
+        }
         else {
-            //case 2: search pointer is not NULL and insert pointer is NULL
-            set_pointer(get_pred_ptr(ptr), find_ptr);
-            set_pointer(get_succ_ptr(ptr), NULL);
-            set_pointer(get_succ_ptr(find_ptr), ptr);
-            seg_freelist[lst] = ptr;
-        }
-    }
-    else {  
-        if (insert_ptr != NULL) {
-            //case 3: search pointer NULL and insert pointer is not NULL
-            set_pointer(get_pred_ptr(ptr), NULL);
-            set_pointer(get_succ_ptr(ptr), insert_ptr);
-            set_pointer(get_pred_ptr(insert_ptr), ptr);
-        } 
+            set_pointer(right, root);
+            right = get_pred_ptr(root);
+            root = get_pred(root);
+        }
+    }
+    set_pointer(left, NULL);
+    set_pointer(right, NULL);
+}
+
+static void tree_delete(void *link, void *ptr)
+{
+    void *left = get_pred(ptr);
+    void *right = get_succ(ptr);
+    void *node;
+
+    // find the link to ptr
+    while ((node = read_pointer(link)) != ptr)
+        link = (ptr < node) ? get_pred_ptr(node) : get_succ_ptr(node);
+
+    // replace it by the merge of its subtrees
+    while ((left != NULL) && (right != NULL)) {
+        if (tree_prio(left) > tree_prio(right)) {
+            set_pointer(link, left);
+            link = get_succ_ptr(left);
+            left = get_succ(left);
+        }
         else {
-            //case 4: search pointer is NULL and insert pointer is NULL
-            set_pointer(get_pred_ptr(ptr), NULL);
-            set_pointer(get_succ_ptr(ptr), NULL);
-            seg_freelist[lst] = ptr;
+            set_pointer(link, right);
+            link = get_pred_ptr(right);
+            right = get_pred(right);
+        }
+    }
+    set_pointer(link, (left != NULL) ? left : right);
+}
+
+// Lowest-addressed block of the treap at or above 'key'
+static void *tree_ceil(void *root, const void *key)
+{
+    void *found = NULL;
+
+    while (root != NULL) {
+        if (root >= key) {
+            found = root;
+            root = get_pred(root);
         }
+        else
+            root = get_succ(root);
     }
+    return found;
+}
+
+// Helper functions: Walk a seg list in its order - from the head for
+// MM_ORDER_LIFO, by address for MM_ORDER_ADDRESS.  An address-ordered
+// walk keeps the ancestors still to visit on a stack, so each step is
+// amortized O(1); should a treap ever be deeper than the stack, the walk
+// continues with one root-to-leaf search per step.
+typedef struct {
+    int lst;
+    int depth;                    // entries on stack, -1 after an overflow
+    void *stack[TREE_STACK];
+} list_iter_t;
+
+static inline void iter_descend(list_iter_t *it, void *root, const void *key)
+{
+    while (root != NULL) {
+        if (root >= key) {
+            if (it->depth >= TREE_STACK) {
+                it->depth = -1;
+                return;
+            }
+            it->stack[it->depth++] = root;
+            root = get_pred(root);
+        }
+        else
+            root = get_succ(root);
+    }
+}
+
+// The stack holds blocks of the walk still to come, nearest on top: those
+// are the ones to prefetch
+static inline void *iter_pop(list_iter_t *it, const void *key)
+{
+    if (it->depth < 0)
+        return tree_ceil(read_pointer(&seg_freelist[it->lst]), key);
+    if (it->depth == 0)
+        return NULL;
+    for (int i = 2; (i <= conf.prefetch + 1) && (i <= it->depth); i++)
+        prefetch_node(it->stack[it->depth - i]);
+    return it->stack[--it->depth];
+}
+
+// First block at or after 'key' (LIFO: 'key' itself, a block of the list)
+static inline void *list_from(list_iter_t *it, int lst, void *key)
+{
+    it->lst = lst;
+    it->depth = 0;
+    if (conf.order != MM_ORDER_ADDRESS)
+        return key;
+    iter_descend(it, read_pointer(&seg_freelist[lst]), key);
+    return iter_pop(it, key);
+}
+
+static inline void *list_first(list_iter_t *it, int lst)
+{
+    if (conf.order != MM_ORDER_ADDRESS)
+        return list_from(it, lst, read_pointer(&seg_freelist[lst]));
+    return list_from(it, lst, NULL);
+}
+
+static inline void *list_next(list_iter_t *it, void *ptr)
+{
+    if (conf.order != MM_ORDER_ADDRESS) {
+        void *next = get_pred(ptr);
+        // the caller reads 'next' at once, so prefetching pays from the
+        // block after it on; a LIFO list only reveals that block through
+        // next's links (read now anyway), and the one after it through
+        // links the previous step prefetched
+        if ((next != NULL) && (conf.prefetch > 0)) {
+            void *ahead = get_pred(next);
+            if ((ahead != NULL) && (conf.prefetch > 1))
+                ahead = get_pred(ahead);
+            if (ahead != NULL)
+                prefetch_node(ahead);
+        }
+        return next;
+    }
+    if (it->depth >= 0)
+        iter_descend(it, get_succ(ptr), NULL);
+    return iter_pop(it, (char *) ptr + 1);
+}
+
+// Helper function: Insertion of node (at the head of its seg list, or
+// by address)
+static void node_insert(void *ptr, size_t size)
+{
+    int lst = region_lists(read_region_tag(header_ptr(ptr))) + size_class(size);
+    char *head = read_pointer(&seg_freelist[lst]);
+
+    if (conf.order == MM_ORDER_ADDRESS) {
+        tree_insert(&seg_freelist[lst], ptr);
+        return;
+    }
+
+    set_pointer(get_pred_ptr(ptr), head);
+    set_pointer(get_succ_ptr(ptr), NULL);
+    if (head != NULL)
+        set_pointer(get_succ_ptr(head), ptr);
+    set_pointer(&seg_freelist[lst], ptr);
 }
 
 // Helper function: Deletion of node
 static void node_del(void *ptr)
 {
-    int lst = 0;
-    size_t size = fetch_size(header_ptr(ptr));
-    
-    // choose the seg list 
-    while ((lst < SEGLIST_SIZE - 1) && (size > 1)) {
-        size >>= 1;
-        lst++;
+    int lst = region_lists(read_region_tag(header_ptr(ptr))) + size_class(fetch_size(header_ptr(ptr)));
+
+    // the next-fit rover of an address-ordered list is just an address
+    if (conf.order == MM_ORDER_ADDRESS) {
+        tree_delete(&seg_freelist[lst], ptr);
+        return;
     }
+
+    // keep the next-fit rover on a block that stays in the list
+    if (seg_rover[lst] == ptr)
+        seg_rover[lst] = get_pred(ptr);
     
     if (get_pred(ptr) != NULL) {
         //case 1: pred of ptr is not NULL and succ is not NULL
@@ -292,7 +692,7 @@ static void node_del(void *ptr)
         } else {
             //case 2: pred of ptr is not NULL and succ is NULL
             set_pointer(get_succ_ptr(get_pred(ptr)), NULL);
-            seg_freelist[lst] = get_pred(ptr);
+            set_pointer(&seg_freelist[lst], get_pred(ptr));
         }
     } else {
         //case 3: pred of ptr is NULL and succ is not NULL
@@ -300,7 +700,7 @@ static void node_del(void *ptr)
             set_pointer(get_pred_ptr(get_succ(ptr)), NULL);
         } else {
             // case 4: pred and succ of ptr is NULL (only block in seg list of the specific size class)
-            seg_freelist[lst] = NULL;
+            set_pointer(&seg_freelist[lst], NULL);
         }
     }
 }
@@ -312,11 +712,19 @@ static void *block_coalescing(void *ptr)
     size_t prev_alloc = fetch_alloc(header_ptr(prev_blockptr(ptr)));
     size_t next_alloc = fetch_alloc(header_ptr(next_blockptr(ptr)));
     size_t size = fetch_size(header_ptr(ptr));   
+    size_t region = read_region_tag(header_ptr(ptr));
+    size_t zoff;
   
     // check reallocation tag of previous block, if 1, do not block_coalescing
     if (read_tag(header_ptr(prev_blockptr(ptr)))){
         prev_alloc = 1;
     }
+    // a neighbour of the other region is left alone, like an allocated one
+    if (read_region_tag(header_ptr(prev_blockptr(ptr))) != region)
+        prev_alloc = 1;
+    if (read_region_tag(header_ptr(next_blockptr(ptr))) != region)
+        next_alloc = 1;
+
     
     // Citation: csapp textbook;
     if (prev_alloc==1 && next_alloc==1){                        
@@ -325,43 +733,134 @@ static void *block_coalescing(void *ptr)
     } 
     else if (prev_alloc==1 && next_alloc==0) {                   
         // previous block occupied, next block free
+        // the zero-filled tail (if any) is the one of the next block
+        zoff = size + zero_offset(next_blockptr(ptr));
         node_del(ptr);
         node_del(next_blockptr(ptr));
         size += fetch_size(header_ptr(next_blockptr(ptr)));
         write_word(header_ptr(ptr), set_word(size, 0));
-        write_word(footer_ptr(ptr), set_word(size, 0));
+        write_no_tag(footer_ptr(ptr), set_word(size, 0) | region);
     }
     else if (prev_alloc==0 && next_alloc==1) {
         // previous block free, next block occupied  
+        zoff = fetch_size(header_ptr(prev_blockptr(ptr))) + zero_offset(ptr);
         node_del(ptr);
         node_del(prev_blockptr(ptr));
         size += fetch_size(header_ptr(prev_blockptr(ptr)));
-        write_word(footer_ptr(ptr), set_word(size, 0));
+        write_no_tag(footer_ptr(ptr), set_word(size, 0) | region);
         write_word(header_ptr(prev_blockptr(ptr)), set_word(size, 0));
         ptr = prev_blockptr(ptr);
     } 
     else {                                                
         // previous and next blocks free
+        zoff = fetch_size(header_ptr(prev_blockptr(ptr))) + size + zero_offset(next_blockptr(ptr));
         node_del(ptr);
         node_del(prev_blockptr(ptr));
         node_del(next_blockptr(ptr));
         size += fetch_size(header_ptr(prev_blockptr(ptr))) + fetch_size(header_ptr(next_blockptr(ptr)));
         write_word(header_ptr(prev_blockptr(ptr)), set_word(size, 0));
-        write_word(footer_ptr(next_blockptr(ptr)), set_word(size, 0));
+        write_no_tag(footer_ptr(next_blockptr(ptr)), set_word(size, 0) | region);
         ptr = prev_blockptr(ptr);
     }
     
     // Insert in appropriate seg list
     node_insert(ptr, size);
+    set_zero_offset(ptr, zoff);
     
     return ptr;
 }
 
+// Helper function: Can a free block hold adj_size bytes
+static inline bool block_fits(void *ptr, size_t adj_size)
+{
+    // don't want blocks of inappropriate size or the blocks with reallocation bit=1
+    return (adj_size <= fetch_size(header_ptr(ptr))) && !read_tag(header_ptr(ptr));
+}
+
+// Helper function: Pick a block of seg list 'lst' according to the fit policy
+static void *list_fit(int lst, size_t adj_size)
+{
+    void *ptr;
+    void *best = NULL;
+    void *start;
+    long seen = 0;
+    list_iter_t it;
+
+    switch (conf.fit) {
+    case MM_FIT_NEXT:
+        // resume after the block taken last time, then wrap around
+        start = list_from(&it, lst, seg_rover[lst]);
+        for (ptr = start; ptr != NULL; ptr = list_next(&it, ptr)) {
+            if (block_fits(ptr, adj_size))
+                break;
+        }
+        if (ptr == NULL) {
+            for (ptr = list_first(&it, lst); ptr != start; ptr = list_next(&it, ptr)) {
+                if (block_fits(ptr, adj_size))
+                    break;
+            }
+            if (ptr == start)
+                ptr = NULL;
+        }
+        if (ptr != NULL)
+            seg_rover[lst] = (conf.order == MM_ORDER_ADDRESS) ? ptr : get_pred(ptr);
+        return ptr;
+
+    case MM_FIT_BEST:
+    case MM_FIT_GOOD:
+        // smallest fitting block of the list (of the first good_n fits)
+        for (ptr = list_first(&it, lst); ptr != NULL; ptr = list_next(&it, ptr)) {
+            if (!block_fits(ptr, adj_size))
+                continue;
+            if ((best == NULL) || (fetch_size(header_ptr(ptr)) < fetch_size(header_ptr(best))))
+                best = ptr;
+            if (fetch_size(header_ptr(ptr)) == adj_size)
+                break;
+            if ((conf.fit == MM_FIT_GOOD) && (++seen >= conf.good_n))
+                break;
+        }
+        return best;
+
+    default:
+        for (ptr = list_first(&it, lst); ptr != NULL; ptr = list_next(&it, ptr)) {
+            if (block_fits(ptr, adj_size))
+                break;
+        }
+        return ptr;
+    }
+}
+
+// Helper function: Search the seg lists of a region for a free block of adj_size bytes
+static void *find_fit(size_t adj_size, size_t region)
+{
+    int base = region_lists(region);
+    void *ptr;
+    
+    // search for free block in seg list, starting with the size class of adj_size
+    for (int idx = size_class(adj_size); (idx < SEGLIST_SIZE); idx++) {
+        if ((idx == SEGLIST_SIZE - 1) || (read_pointer(&seg_freelist[base + idx]) != NULL)) {
+            if ((ptr = list_fit(base + idx, adj_size)) != NULL)
+                return ptr;
+        }       
+    }
+    return NULL;
+}
+
+// Helper function: Does a block of adj_size go to the high end of a split
+static inline bool split_high(size_t adj_size)
+{
+    if (conf.split == MM_SPLIT_SIZE)
+        return adj_size >= (size_t) conf.split_limit;
+    return conf.split == MM_SPLIT_HIGH;
+}
+
 // Helper function: Place block of adj_size bytes - split free blocks
 static void *insert_block(void *ptr, size_t adj_size)
 {
     size_t tot_size = fetch_size(header_ptr(ptr));
     size_t rem_size = tot_size - adj_size;
+    size_t zoff = zero_offset(ptr);
+    size_t region = read_region_tag(header_ptr(ptr));
     
     node_del(ptr);
     
@@ -369,29 +868,280 @@ static void *insert_block(void *ptr, size_t adj_size)
     if (rem_size < DOUBLESIZE*2) { 
         // no splitting of block
         write_word(header_ptr(ptr), set_word(tot_size, 1)); 
-        write_word(footer_ptr(ptr), set_word(tot_size, 1)); 
+        write_no_tag(footer_ptr(ptr), set_word(tot_size, 1) | region); 
+        place_dirty = zoff;
     }    
-    else if (adj_size >= 100) {
+    else if (split_high(adj_size)) {
         // splitting of block
         write_word(header_ptr(ptr), set_word(rem_size, 0));
-        write_word(footer_ptr(ptr), set_word(rem_size, 0));
-        write_no_tag(header_ptr(next_blockptr(ptr)), set_word(adj_size, 1));
-        write_no_tag(footer_ptr(next_blockptr(ptr)), set_word(adj_size, 1));
+        write_no_tag(footer_ptr(ptr), set_word(rem_size, 0) | region);
+        write_no_tag(header_ptr(next_blockptr(ptr)), set_word(adj_size, 1) | region);
+        write_no_tag(footer_ptr(next_blockptr(ptr)), set_word(adj_size, 1) | region);
         node_insert(ptr, rem_size);
+        set_zero_offset(ptr, zoff);
+        place_dirty = (zoff > rem_size) ? zoff - rem_size : 0;
         return next_blockptr(ptr);
     }
     else {
         write_word(header_ptr(ptr), set_word(adj_size, 1)); 
-        write_word(footer_ptr(ptr), set_word(adj_size, 1));
-        write_no_tag(header_ptr(next_blockptr(ptr)), set_word(rem_size, 0)); 
-        write_no_tag(footer_ptr(next_blockptr(ptr)), set_word(rem_size, 0)); 
+        write_no_tag(footer_ptr(ptr), set_word(adj_size, 1) | region);
+        write_no_tag(header_ptr(next_blockptr(ptr)), set_word(rem_size, 0) | region); 
+        write_no_tag(footer_ptr(next_blockptr(ptr)), set_word(rem_size, 0) | region); 
         node_insert(next_blockptr(ptr), rem_size);
+        set_zero_offset(next_blockptr(ptr), (zoff > adj_size) ? zoff - adj_size : 0);
+        place_dirty = zoff;
     }
 
     return ptr;
 }
+
+// Helper function: Return an allocated block to the seg lists and coalesce it
+static void block_release(void *ptr)
+{
+    size_t size = fetch_size(header_ptr(ptr));
+
+    // changing the allocation bit of the header and footer
+    write_word(header_ptr(ptr), set_word(size, 0));
+    write_no_tag(footer_ptr(ptr), set_word(size, 0) | read_region_tag(header_ptr(ptr)));
+    
+    node_insert(ptr, size);
+    block_coalescing(ptr);
+}
+
+// Helper function: Return the blocks of the quick list of 'gran' granules
+static void quick_flush(size_t gran)
+{
+    void *ptr;
+
+    while ((ptr = quick_head[gran]) != NULL) {
+        quick_head[gran] = get_pred(ptr);
+        quick_bytes -= gran * ALIGNMENT;
+        block_release(ptr);
+    }
+}
+
+// Helper function: Empty all quick lists (before growing the heap, or
+// when they hold more than conf.quick_bytes)
+static void quick_flush_all(void)
+{
+    for (size_t gran = 0; (gran <= QUICK_GRANULES) && (quick_bytes > 0); gran++)
+        quick_flush(gran);
+}
+
+// Helper function: End of a window of frees - pick the hot sizes again,
+// flush the lists of sizes that went cold and decay the counts
+static void quick_update(void)
+{
+    for (size_t gran = 0; gran <= QUICK_GRANULES; gran++) {
+        quick_hot[gran] = (quick_count[gran] * QUICK_HOT_SHARE >= QUICK_WINDOW);
+        if (!quick_hot[gran])
+            quick_flush(gran);
+        quick_count[gran] >>= 1;
+    }
+    quick_frees = 0;
+}
+
+// Helper function: qsort comparison of two block pointers by address
+static int pending_cmp(const void *a, const void *b)
+{
+    const char *x = *(void *const *) a;
+    const char *y = *(void *const *) b;
+    return (x > y) - (x < y);
+}
+
+// Helper function: The stack of deferred frees of a small block size in a region (a region tag)
+static inline void **pending_stack(size_t size, size_t region)
+{
+    return &pending_head[region ? 1 : 0][size / ALIGNMENT];
+}
+
+// Helper function: Release the deferred frees.  In address order, runs of
+// adjacent blocks of one region are merged by rewriting one header and footer, so each
+// run costs a single insertion and coalescing with its free neighbours.
+static void pending_flush(void)
+{
+    size_t i = 0;
+    size_t n = pending_large;
+
+    for (int reg = 0; (reg < REGIONS) && (n < pending_n); reg++) {
+        for (int gran = 0; (gran <= QUICK_GRANULES) && (n < pending_n); gran++) {
+            for (char *ptr = pending_head[reg][gran]; ptr != NULL; ptr = get_pred(ptr))
+                pending[n++] = ptr;
+            pending_head[reg][gran] = NULL;
+        }
+    }
+    qsort(pending, n, sizeof(void *), pending_cmp);
+    while (i < n) {
+        char *ptr = pending[i++];
+        size_t size = fetch_size(header_ptr(ptr));
+        size_t region = read_region_tag(header_ptr(ptr));
+        while ((i < n) && (pending[i] == ptr + size) &&
+               (read_region_tag(header_ptr(pending[i])) == region))
+            size += fetch_size(header_ptr(pending[i++]));
+        write_word(header_ptr(ptr), set_word(size, 1));
+        write_no_tag(footer_ptr(ptr), set_word(size, 1) | region);
+        block_release(ptr);
+    }
+    pending_large = 0;
+    pending_n = 0;
+}
+
+// Helper function: Release the blocks of the inline bins; returns how many
+static size_t inline_flush(void)
+{
+    size_t n = 0;
+    void *ptr;
+
+    for (int bin = 0; bin < MM_INLINE_BINS; bin++) {
+        while ((ptr = mm_inline_bins[bin].head) != NULL) {
+            mm_inline_bins[bin].head = *(void **) ptr;
+            block_release(ptr);
+            n++;
+        }
+        mm_inline_bins[bin].count = conf.lock ? MM_INLINE_DEPTH : 0;
+    }
+    return n;
+}
 // End-of HELPER Functions
 
+////
+//// Configuration ////
+////
+// Helper function: Apply CONFIG_ENV once, before any explicit setting
+static void config_from_env(void)
+{
+    if (conf_env_done)
+        return;
+    conf_env_done = true;
+    const char *spec = getenv(CONFIG_ENV);
+    if ((spec != NULL) && !mm_config_parse(spec))
+        fprintf(stderr, "mm: ignoring bad setting in %s='%s'\n", CONFIG_ENV, spec);
+}
+
+/*
+ * mm_config - set a tuning parameter; it takes effect at the next mm_init.
+ * Returns false if the parameter or the value is invalid.
+ */
+bool mm_config(mm_param_t param, long value)
+{
+    config_from_env();
+    switch (param) {
+    case MM_CFG_ORDER:
+        if ((value < MM_ORDER_LIFO) || (value > MM_ORDER_ADDRESS))
+            return false;
+        conf_next.order = value;
+        return true;
+    case MM_CFG_FIT:
+        if ((value < MM_FIT_FIRST) || (value > MM_FIT_GOOD))
+            return false;
+        conf_next.fit = value;
+        return true;
+    case MM_CFG_SPLIT:
+        if ((value < MM_SPLIT_SIZE) || (value > MM_SPLIT_HIGH))
+            return false;
+        conf_next.split = value;
+        return true;
+    case MM_CFG_SPLIT_LIMIT:
+        if (value < 0)
+            return false;
+        conf_next.split_limit = value;
+        return true;
+    case MM_CFG_GOOD_N:
+        if (value < 1)
+            return false;
+        conf_next.good_n = value;
+        return true;
+    case MM_CFG_QUICK_BYTES:
+        if (value < 0)
+            return false;
+        conf_next.quick_bytes = value;
+        return true;
+    case MM_CFG_DEFER:
+        if ((value < 0) || (value > DEFER_MAX))
+            return false;
+        conf_next.defer = value;
+        return true;
+    case MM_CFG_THREAD_LINES:
+        conf_next.thread_lines = (value != 0);
+        return true;
+    case MM_CFG_PREFETCH:
+        if ((value < 0) || (value > PREFETCH_MAX))
+            return false;
+        conf_next.prefetch = value;
+        return true;
+    case MM_CFG_LOCK:
+        conf_next.lock = (value != 0);
+        return true;
+    }
+    return false;
+}
+
+// Helper function: Map a symbolic value of a 'key=value' setting
+static long config_value(const char *val, size_t len, const char *const *names)
+{
+    for (long i = 0; names[i] != NULL; i++) {
+        if ((strlen(names[i]) == len) && (strncmp(val, names[i], len) == 0))
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * mm_config_parse - apply comma separated 'key=value' settings, e.g.
+ * "order=address,fit=good,good_n=8,split=low,quick=0,defer=64,thread_lines=1".  Returns false on the first bad one.
+ */
+bool mm_config_parse(const char *spec)
+{
+    static const char *const fit_names[] = { "first", "next", "best", "good", NULL };
+    static const char *const split_names[] = { "size", "low", "high", NULL };
+    static const char *const order_names[] = { "lifo", "address", NULL };
+
+    while (*spec != '\0') {
+        const char *end = strchr(spec, ',');
+        const char *eq = strchr(spec, '=');
+        if (end == NULL)
+            end = spec + strlen(spec);
+        if ((eq == NULL) || (eq > end))
+            return false;
+
+        size_t klen = eq - spec;
+        const char *val = eq + 1;
+        size_t vlen = end - val;
+        char *num_end;
+        long num = strtol(val, &num_end, 0);
+        bool is_num = (vlen > 0) && (num_end == end);
+        bool ok;
+
+        if ((klen == 5) && (strncmp(spec, "order", 5) == 0))
+            ok = mm_config(MM_CFG_ORDER, config_value(val, vlen, order_names));
+        else if ((klen == 3) && (strncmp(spec, "fit", 3) == 0))
+            ok = mm_config(MM_CFG_FIT, config_value(val, vlen, fit_names));
+        else if ((klen == 5) && (strncmp(spec, "split", 5) == 0))
+            ok = mm_config(MM_CFG_SPLIT, config_value(val, vlen, split_names));
+        else if ((klen == 11) && (strncmp(spec, "split_limit", 11) == 0))
+            ok = is_num && mm_config(MM_CFG_SPLIT_LIMIT, num);
+        else if ((klen == 6) && (strncmp(spec, "good_n", 6) == 0))
+            ok = is_num && mm_config(MM_CFG_GOOD_N, num);
+        else if ((klen == 5) && (strncmp(spec, "quick", 5) == 0))
+            ok = is_num && mm_config(MM_CFG_QUICK_BYTES, num);
+        else if ((klen == 5) && (strncmp(spec, "defer", 5) == 0))
+            ok = is_num && mm_config(MM_CFG_DEFER, num);
+        else if ((klen == 12) && (strncmp(spec, "thread_lines", 12) == 0))
+            ok = is_num && mm_config(MM_CFG_THREAD_LINES, num);
+        else if ((klen == 8) && (strncmp(spec, "prefetch", 8) == 0))
+            ok = is_num && mm_config(MM_CFG_PREFETCH, num);
+        else if ((klen == 4) && (strncmp(spec, "lock", 4) == 0))
+            ok = is_num && mm_config(MM_CFG_LOCK, num);
+        else
+            ok = false;
+        if (!ok)
+            return false;
+
+        spec = (*end == ',') ? end + 1 : end;
+    }
+    return true;
+}
+
 ////
 //// Main Functions ////
 ////
@@ -400,28 +1150,64 @@ static void *insert_block(void *ptr, size_t adj_size)
  */
 bool mm_init(void)
 {
+    // pick up the settings made with mm_config (or the environment)
+    config_from_env();
+    conf = conf_next;
+
+#ifdef MM_SIDE_META
+    // map the side table for the largest heap once; its pages are only
+    // committed as metadata gets written
+    if (side_meta == NULL) {
+        side_meta = mmap(NULL, SIDE_MAX_HEAP / WORDSIZE * sizeof(meta_t), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (side_meta == MAP_FAILED) {
+            side_meta = NULL;
+            return false;
+        }
+    }
+    meta_base = mem_heap_lo();
+#endif
+
     // allocate memory
     if ((long)(heap_ptr = mem_sbrk(4*WORDSIZE)) == -1){
         return false;
     }
     
     // Initialize seg free lists
-    for (int indx = 0; indx < SEGLIST_SIZE; indx++) {
-        seg_freelist[indx] = NULL;
+    for (int indx = 0; indx < REGIONS * SEGLIST_SIZE; indx++) {
+        set_pointer(&seg_freelist[indx], NULL);
+        seg_rover[indx] = NULL;
+    }
+    for (int gran = 0; gran <= QUICK_GRANULES; gran++) {
+        quick_head[gran] = NULL;
+        quick_count[gran] = 0;
+        quick_hot[gran] = false;
+    }
+    quick_bytes = 0;
+    quick_frees = 0;
+    for (int reg = 0; reg < REGIONS; reg++)
+        for (int gran = 0; gran <= QUICK_GRANULES; gran++)
+            pending_head[reg][gran] = NULL;
+    pending_large = 0;
+    pending_n = 0;
+    last_thread = NULL;
+    for (int bin = 0; bin < MM_INLINE_BINS; bin++) {
+        mm_inline_bins[bin].head = NULL;
+        mm_inline_bins[bin].count = conf.lock ? MM_INLINE_DEPTH : 0;
     }
     
     // citation: csapp textbook;   
-    write_no_tag(heap_ptr, 0); // padding
+    write_no_tag(meta_addr(heap_ptr), 0); // padding
     // start of heap mem block header (prologue)                         
-    write_no_tag(heap_ptr + (1 * WORDSIZE), set_word(DOUBLESIZE, 1));
+    write_no_tag(meta_addr(heap_ptr + (1 * WORDSIZE)), set_word(DOUBLESIZE, 1));
     // prologue footer
-    write_no_tag(heap_ptr + (2 * WORDSIZE), set_word(DOUBLESIZE, 1));
+    write_no_tag(meta_addr(heap_ptr + (2 * WORDSIZE)), set_word(DOUBLESIZE, 1));
     // last block of heap header(epilogue)
-    write_no_tag(heap_ptr + (3 * WORDSIZE), set_word(0, 1));
+    write_no_tag(meta_addr(heap_ptr + (3 * WORDSIZE)), set_word(0, 1));
     
     // Extend heap, when mem_sbrk failed to provide memory
     size_t size = INITIALCHUNK;
-    if (heap_extension(size) == NULL) 
+    if (heap_extension(size, 0) == NULL) 
         return false;
 
     mm_checkheap(__LINE__);
@@ -429,9 +1215,10 @@ bool mm_init(void)
 }
 
 /*
- * malloc
+ * block_alloc - malloc in a region: the default one (0) or the
+ * short-lived one (0x8), which has its own seg lists and heap chunks
  */
-void* malloc(size_t size)
+static void *block_alloc(size_t size, size_t region)
 {
     size_t adj_size;
     size_t extending_size;
@@ -440,6 +1227,11 @@ void* malloc(size_t size)
     // Ignore request
     if (size == 0)
         return NULL;
+    // Refuse a size whose block size would overflow (or not fit mem_sbrk's increment)
+    if (size > PTRDIFF_MAX - DOUBLESIZE - ALIGNMENT) {
+        errno = ENOMEM;
+        return NULL;
+    }
     
     // Citation: csapp textbook; 
 /*  if (size <= DOUBLESIZE)
@@ -451,29 +1243,76 @@ void* malloc(size_t size)
 //*    adj_size = align(size+DOUBLESIZE);
     adj_size = (((size+DOUBLESIZE)+(ALIGNMENT-1)) & ~0xf);
 
-    size_t find_size = adj_size;
-    
-    // search for free block in seg list 
-    for (int idx=0; (idx < SEGLIST_SIZE); idx++) {
-        if ((idx == SEGLIST_SIZE - 1) || ((find_size <= 1) && (seg_freelist[idx] != NULL))) {
-            ptr = seg_freelist[idx];
-            // don't want blocks of inappropriate size or the blocks with reallocation bit=1
-            while ((ptr != NULL) && ((adj_size > fetch_size(header_ptr(ptr))) || (read_tag(header_ptr(ptr))))) {
-                ptr = get_pred(ptr);
+    // a recently freed block of exactly this size: just unlink it
+    if ((region == 0) && (adj_size <= QUICK_GRANULES * ALIGNMENT) &&
+        (quick_head[adj_size / ALIGNMENT] != NULL)) {
+        ptr = quick_head[adj_size / ALIGNMENT];
+        quick_head[adj_size / ALIGNMENT] = get_pred(ptr);
+        quick_bytes -= adj_size;
+        place_dirty = adj_size;
+        mm_checkheap(__LINE__);
+        return ptr;
+    }
+
+    // reuse a deferred free of exactly this size: a small one from the top
+    // of its stack, a larger one by a scan, newest first
+    if ((adj_size <= QUICK_GRANULES * ALIGNMENT) && (pending_n > pending_large)) {
+        void **stack = pending_stack(adj_size, region);
+        if ((ptr = *stack) != NULL) {
+            *stack = get_pred(ptr);
+            pending_n--;
+            place_dirty = adj_size;
+            mm_checkheap(__LINE__);
+            return ptr;
+        }
+    }
+    else if (adj_size > QUICK_GRANULES * ALIGNMENT) {
+        for (size_t i = pending_large; i-- > 0; ) {
+            if ((fetch_size(header_ptr(pending[i])) == adj_size) &&
+                (read_region_tag(header_ptr(pending[i])) == region)) {
+                ptr = pending[i];
+                pending[i] = pending[--pending_large];
+                pending_n--;
+                place_dirty = adj_size;
+                mm_checkheap(__LINE__);
+                return ptr;
             }
-            if (ptr != NULL)
-                break;
-        }       
-        find_size >>= 1;
+        }
+    }
+
+    // search for free block in seg list according to the fit policy
+    ptr = find_fit(adj_size, region);
+
+    // coalesce the deferred frees and give the quick-listed and inline
+    // binned blocks back before growing the heap
+    if (ptr == NULL) {
+        bool flushed = (pending_n > 0) || (quick_bytes > 0);
+        pending_flush();
+        quick_flush_all();
+        if ((inline_flush() > 0) || flushed)
+            ptr = find_fit(adj_size, region);
+    }
+
+    // rather than growing the heap, move a free block of the other region
+    // over, where it may now coalesce with its neighbours
+    if ((ptr == NULL) && ((ptr = find_fit(adj_size, region ^ 0x8)) != NULL)) {
+        node_del(ptr);
+        write_no_tag(header_ptr(ptr), set_word(fetch_size(header_ptr(ptr)), 0) | region);
+        write_no_tag(footer_ptr(ptr), set_word(fetch_size(header_ptr(ptr)), 0) | region);
+        node_insert(ptr, fetch_size(header_ptr(ptr)));
+        ptr = block_coalescing(ptr);
     }
     
     // need to extend heap if free block not found
     if (ptr == NULL) {
         // Citation: csapp textbook; 
         //extending_size = maximum(adj_size, CHUNK);
-        extending_size = adj_size;
-        if ((ptr = heap_extension(extending_size)) == NULL)
+        // short-lived blocks are packed into chunks of their own
+        extending_size = region ? maximum(adj_size, SHORT_CHUNK) : adj_size;
+        if ((ptr = heap_extension(extending_size, region)) == NULL) {
+            errno = ENOMEM;
             return NULL;
+        }
     }
     
     // need to place the block, and then split if larger than required block was allocated
@@ -483,32 +1322,242 @@ void* malloc(size_t size)
     return (char *) ptr;
 }
 
+// Helper function: Give the tail of an allocated block beyond its first
+// adj_size bytes back to the seg lists, if it can make a block of its own
+static void block_trim(void *ptr, size_t adj_size)
+{
+    size_t size = fetch_size(header_ptr(ptr));
+    size_t region = read_region_tag(header_ptr(ptr));
+
+    if (size - adj_size < DOUBLESIZE*2)
+        return;
+    write_word(header_ptr(ptr), set_word(adj_size, 1));
+    write_no_tag(footer_ptr(ptr), set_word(adj_size, 1) | region);
+    write_no_tag(header_ptr(next_blockptr(ptr)), set_word(size - adj_size, 1) | region);
+    write_no_tag(footer_ptr(next_blockptr(ptr)), set_word(size - adj_size, 1) | region);
+    block_release(next_blockptr(ptr));
+}
+
 /*
- * free
+ * block_alloc_aligned - block_alloc at an 'align'-aligned payload (a power
+ * of two): over-allocate, then release the gap in front of the aligned
+ * payload (at least a minimum block, or nothing) and the unused tail
  */
-void free(void *ptr){
+static void *block_alloc_aligned(size_t size, size_t align, size_t region)
+{
+    char *ptr, *aligned_ptr;
+    size_t block_size, gap;
+
+    if (align <= ALIGNMENT)
+        return block_alloc(size, region);
+    if (size == 0)
+        return NULL;
+    if (size > SIZE_MAX - align - 2*DOUBLESIZE) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if ((ptr = block_alloc(size + align + 2*DOUBLESIZE, region)) == NULL)
+        return NULL;
+
+    block_size = fetch_size(header_ptr(ptr));
+    aligned_ptr = (char *) (((size_t) ptr + align - 1) & ~(align - 1));
+    if ((aligned_ptr > ptr) && (aligned_ptr - ptr < DOUBLESIZE*2))
+        aligned_ptr += align;
+    gap = aligned_ptr - ptr;
+
+    if (gap > 0) {
+        write_word(header_ptr(ptr), set_word(gap, 1));
+        write_no_tag(footer_ptr(ptr), set_word(gap, 1) | region);
+        write_no_tag(header_ptr(aligned_ptr), set_word(block_size - gap, 1) | region);
+        write_no_tag(footer_ptr(aligned_ptr), set_word(block_size - gap, 1) | region);
+        block_release(ptr);
+    }
+    block_trim(aligned_ptr, (((size+DOUBLESIZE)+(ALIGNMENT-1)) & ~0xf));
+
+    // nothing is known about the contents of a block put together here
+    place_dirty = fetch_size(header_ptr(aligned_ptr));
+    mm_checkheap(__LINE__);
+    return aligned_ptr;
+}
+
+// Helper function: A block that owns the cache lines of its payload
+static void *cacheline_alloc(size_t size, size_t region)
+{
+    if (size == 0)
+        return NULL;
+    if (size > SIZE_MAX - CACHELINE) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return block_alloc_aligned((size + CACHELINE - 1) & ~(size_t) (CACHELINE - 1), CACHELINE, region);
+}
+
+#ifndef DRIVER
+// Helper functions: keep the heap consistent across fork(); the child
+// gets a fresh mutex, as the thread holding it doesn't exist there
+static void fork_prepare(void)
+{
+    pthread_mutex_lock(&heap_mutex);
+}
+
+static void fork_parent(void)
+{
+    pthread_mutex_unlock(&heap_mutex);
+}
+
+static void fork_child(void)
+{
+    pthread_mutex_init(&heap_mutex, NULL);
+}
+
+// Helper function: Set up the heap on first use.  The fork handlers
+// are registered once the heap is ready, in case that allocates.
+static void heap_setup(void)
+{
+    bool first = false;
+
+    pthread_mutex_lock(&setup_mutex);
+    if (!heap_ready) {
+        mem_init();
+        if (!mm_init()) {
+            fprintf(stderr, "mm: could not set up the heap\n");
+            abort();
+        }
+        __atomic_store_n(&heap_ready, true, __ATOMIC_RELEASE);
+        first = true;
+    }
+    pthread_mutex_unlock(&setup_mutex);
+    if (first)
+        pthread_atfork(fork_prepare, fork_parent, fork_child);
+}
+#endif /* !DRIVER */
+
+// Helper functions: MM_CFG_LOCK, taken by the public entry points only
+static inline void heap_lock(void)
+{
+#ifndef DRIVER
+    if (!__atomic_load_n(&heap_ready, __ATOMIC_ACQUIRE))
+        heap_setup();
+#endif
+    if (conf.lock)
+        pthread_mutex_lock(&heap_mutex);
+}
+
+static inline void heap_unlock(void)
+{
+    if (conf.lock)
+        pthread_mutex_unlock(&heap_mutex);
+}
+
+// Helper function: malloc with the heap locked
+static void *block_malloc(size_t size)
+{
+    // MM_CFG_THREAD_LINES: the first malloc after another thread's gets
+    // lines of its own, so consecutive allocations by different threads
+    // are on separate lines; later ones come from the shared free lists
+    // and may still sit next to another thread's objects
+    if (conf.thread_lines && (last_thread != &thread_tag)) {
+        last_thread = &thread_tag;
+        return cacheline_alloc(size, 0);
+    }
+    return block_alloc(size, 0);
+}
+
+/*
+ * malloc
+ */
+void* malloc(size_t size)
+{
+    heap_lock();
+    void *ptr = block_malloc(size);
+    heap_unlock();
+    return ptr;
+}
+
+/*
+ * mm_malloc_hint - malloc with an expected lifetime: MM_HINT_SHORT
+ * blocks come from a region of their own, so short-lived scratch
+ * objects don't fragment the pages of long-lived ones.  With
+ * MM_FLAG_CACHELINE the payload starts on a cache line and is padded
+ * to whole lines, so no other object shares them.
+ */
+void *mm_malloc_hint(size_t size, int flags)
+{
+    size_t region = (flags & MM_HINT_SHORT) ? 0x8 : 0;
+    void *ptr;
+
+    heap_lock();
+    if (flags & MM_FLAG_CACHELINE)
+        ptr = cacheline_alloc(size, region);
+    else
+        ptr = block_alloc(size, region);
+    heap_unlock();
+    return ptr;
+}
+
+// Helper function: free with the heap locked
+static void block_free(void *ptr){
 
-    /* IMPLEMENT THIS */
     if (ptr == NULL){
         return;
     }
 
     // get size of block pointed to by ptr
     size_t size = fetch_size(header_ptr(ptr));
+    size_t gran = size / ALIGNMENT;
     
     del_realloc_tag(header_ptr(next_blockptr(ptr)));
 
-    // changing the allocation bit of the header and footer
-    write_word(header_ptr(ptr), set_word(size, 0));
-    write_word(footer_ptr(ptr), set_word(size, 0));
-    
-    node_insert(ptr, size);
-    block_coalescing(ptr);
+    // blocks of hot small sizes are kept allocated on their quick list
+    if ((conf.quick_bytes > 0) && (gran <= QUICK_GRANULES) && !read_region_tag(header_ptr(ptr))) {
+        quick_count[gran]++;
+        if (++quick_frees >= QUICK_WINDOW)
+            quick_update();
+        if (quick_hot[gran]) {
+            if (quick_bytes + size > (size_t) conf.quick_bytes)
+                quick_flush_all();
+            set_pointer(get_pred_ptr(ptr), quick_head[gran]);
+            quick_head[gran] = ptr;
+            quick_bytes += size;
+            mm_checkheap(__LINE__);
+            return;
+        }
+    }
+
+    // deferred mode: coalesce later, in one pass over a full buffer
+    if (conf.defer > 0) {
+        if (pending_n >= (size_t) conf.defer)
+            pending_flush();
+        if (gran <= QUICK_GRANULES) {
+            void **stack = pending_stack(size, read_region_tag(header_ptr(ptr)));
+            set_pointer(get_pred_ptr(ptr), *stack);
+            *stack = ptr;
+        }
+        else
+            pending[pending_large++] = ptr;
+        pending_n++;
+        mm_checkheap(__LINE__);
+        return;
+    }
+
+    block_release(ptr);
     
     mm_checkheap(__LINE__);
     return;
 }
 
+/*
+ * free
+ */
+void free(void *ptr){
+    if (ptr == NULL){
+        return;
+    }
+    heap_lock();
+    block_free(ptr);
+    heap_unlock();
+}
+
 /*
  * realloc
  */
@@ -526,20 +1575,22 @@ void *realloc(void *oldptr, size_t size)
         return malloc(size);
     }
    
-    // Allocate memory of the new size using malloc
-    char *newptr = (char *) malloc(size);
+    heap_lock();
+    // Allocate memory of the new size in the region of the old block
+    char *newptr = (char *) block_alloc(size, read_region_tag(header_ptr(oldptr)));
     if (newptr == NULL) {
+        heap_unlock();
         return NULL; //returns NULL if malloc fails
     }
     
-    // Copy data from old location to new location
-    //size_t cpy_size = minimum(size, fetch_size(header_ptr(oldptr)) - WORDSIZE);
-    size_t cpy_size = size;
+    // Copy only the live part of the old payload (block minus header and footer)
+    size_t cpy_size = minimum(size, fetch_size(header_ptr(oldptr)) - DOUBLESIZE);
     memcpy(newptr, oldptr, cpy_size);        
     
-    free(oldptr);
+    block_free(oldptr);
 
     mm_checkheap(__LINE__);
+    heap_unlock();
     
     return newptr;
 }
@@ -547,19 +1598,122 @@ void *realloc(void *oldptr, size_t size)
 
 /*
  * calloc
- * This function is not tested by mdriver, and has been implemented for you.
+ * Only the part of the block that is not known to be zero-filled
+ * (fresh heap memory) gets cleared.
  */
 void* calloc(size_t nmemb, size_t size)
 {
     void* ptr;
+
+    // Reject requests whose total size does not fit in a size_t
+    if (nmemb != 0 && size > SIZE_MAX / nmemb) {
+        errno = ENOMEM;
+        return NULL;
+    }
     size *= nmemb;
-    ptr = malloc(size);
+    heap_lock();
+    ptr = block_malloc(size);
     if (ptr) {
-        memset(ptr, 0, size);
+        memset(ptr, 0, minimum(size, place_dirty));
     }
+    heap_unlock();
     return ptr;
 }
 
+/*
+ * memalign - a block whose payload is a multiple of 'alignment', a
+ * power of two; NULL (EINVAL) for any other alignment
+ */
+void *memalign(size_t alignment, size_t size)
+{
+    void *ptr;
+
+    if ((alignment == 0) || ((alignment & (alignment - 1)) != 0)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    heap_lock();
+    if (alignment <= ALIGNMENT)
+        ptr = block_malloc(size);
+    else
+        ptr = block_alloc_aligned(size, alignment, 0);
+    heap_unlock();
+    return ptr;
+}
+
+/*
+ * posix_memalign - memalign that returns an error number; the
+ * alignment must also be a multiple of sizeof(void *)
+ */
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *ptr;
+
+    if ((alignment % sizeof(void *)) != 0 || (alignment & (alignment - 1)) != 0 ||
+        (alignment == 0))
+        return EINVAL;
+    if ((ptr = memalign(alignment, size)) == NULL && size != 0)
+        return ENOMEM;
+    *memptr = ptr;
+    return 0;
+}
+
+/*
+ * aligned_alloc - C11 name of memalign
+ */
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+/*
+ * valloc, pvalloc - page-aligned blocks; pvalloc rounds the size up to
+ * whole pages as well
+ */
+void *valloc(size_t size)
+{
+    return memalign(mem_pagesize(), size);
+}
+
+void *pvalloc(size_t size)
+{
+    size_t page = mem_pagesize();
+
+    if (size > SIZE_MAX - page) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return memalign(page, (size + page - 1) & ~(page - 1));
+}
+
+/*
+ * reallocarray - realloc to nmemb * size bytes, unless that overflows
+ */
+void *reallocarray(void *oldptr, size_t nmemb, size_t size)
+{
+    if (nmemb != 0 && size > SIZE_MAX / nmemb) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return realloc(oldptr, nmemb * size);
+}
+
+/*
+ * malloc_usable_size - payload bytes of an allocated block, which may
+ * exceed the size that was asked for
+ */
+size_t malloc_usable_size(void *ptr)
+{
+    size_t size;
+
+    if (ptr == NULL)
+        return 0;
+    heap_lock();
+    size = fetch_size(header_ptr(ptr)) - DOUBLESIZE;
+    heap_unlock();
+    return size;
+}
+
 /*
  * Returns whether the pointer is in the heap.
  * May be useful for debugging.
@@ -601,7 +1755,6 @@ bool mm_checkheap(int lineno)
 
     if (lineno <= 0) 
         return false;
-    dbg_printf("\n ************* Line number: %d  ***************\n" , lineno);
     
     char *start_blockptr = heap_ptr + DOUBLESIZE;
     char *block_ptr;
@@ -633,13 +1786,6 @@ bool mm_checkheap(int lineno)
 
         hsize = fetch_size(header_ptr(block_ptr));
         halloc = fetch_alloc(header_ptr(block_ptr)); 
-        fsize = fetch_size(footer_ptr(block_ptr));
-        falloc = fetch_alloc(footer_ptr(block_ptr));    
-        
-        // Information of the block e.g. Block address, size and allocations.
-        dbg_printf("Block address is: %p\n", block_ptr);
-        dbg_printf("Header and Footer size is: %zu, fsize = %zu\n", hsize, fsize);
-        dbg_printf("Header and Footer alloc is: %zu, falloc = %zu\n", halloc, falloc);
 
         // [Unit-test:5] Check if block pointer lies within heap
         if (!in_heap(block_ptr)) {
@@ -662,9 +1808,35 @@ bool mm_checkheap(int lineno)
         // [Unit-test:8] Check if the header and footer are different
         if ((header_ptr(block_ptr)) == (footer_ptr(block_ptr))) {
             dbg_printf("Footer is the same as the Header)");
-            return false;  
+            return false;
+        }
+
+        // [Unit-test:10] Check that a known-zero free block really is zero-filled
+        if (!halloc && read_zero_tag(header_ptr(block_ptr))) {
+            for (size_t off = zero_offset(block_ptr); off < hsize - DOUBLESIZE; off++) {
+                if (block_ptr[off] != 0) {
+                    dbg_printf("Known-zero block has non-zero byte at offset %zu\n", off);
+                    return false;
+                }
+            }
+        }
+
+        // [Unit-test:15] Check that header and footer agree, and that no two free blocks
+        // of a region are left side by side (unless the first is kept for a realloc)
+        if ((fetch_size(footer_ptr(block_ptr)) != hsize) ||
+            (fetch_alloc(footer_ptr(block_ptr)) != halloc) ||
+            (read_region_tag(footer_ptr(block_ptr)) != read_region_tag(header_ptr(block_ptr)))) {
+            dbg_printf("Header and footer of %p disagree\n", block_ptr);
+            return false;
         }
-          
+        if (!halloc && !read_tag(header_ptr(block_ptr)) &&
+            !fetch_alloc(header_ptr(next_blockptr(block_ptr))) &&
+            (read_region_tag(header_ptr(next_blockptr(block_ptr))) == read_region_tag(header_ptr(block_ptr)))) {
+            dbg_printf("Free blocks %p and %p were not coalesced\n", block_ptr, next_blockptr(block_ptr));
+            return false;
+        }
+    } //end-of For loop    
+
     // [Unit-test:9] Check the epilogue's Header info.
     hsize = fetch_size(header_ptr(block_ptr) );
     halloc = fetch_alloc(header_ptr(block_ptr) ); 
@@ -672,8 +1844,86 @@ bool mm_checkheap(int lineno)
         dbg_printf("Last-block header is incorrect \n");
         return false;
     }
-      
-  } //end-of For loop    
+
+    // [Unit-test:11] Check that quick-listed blocks are allocated blocks of their list's size,
+    // within the limit, and that quick_bytes counts them
+    size_t quick_total = 0;
+    for (size_t gran = 0; gran <= QUICK_GRANULES; gran++) {
+        for (block_ptr = quick_head[gran]; block_ptr != NULL; block_ptr = get_pred(block_ptr)) {
+            if (!in_heap(block_ptr) || !fetch_alloc(header_ptr(block_ptr)) ||
+                (fetch_size(header_ptr(block_ptr)) != gran * ALIGNMENT) ||
+                (read_region_tag(header_ptr(block_ptr)) != 0)) {
+                dbg_printf("Bad block %p on quick list %zu\n", block_ptr, gran);
+                return false;
+            }
+            quick_total += gran * ALIGNMENT;
+        }
+    }
+    if ((quick_total != quick_bytes) || (quick_bytes > (size_t) conf.quick_bytes)) {
+        dbg_printf("Quick lists hold %zu bytes, quick_bytes is %zu\n", quick_total, quick_bytes);
+        return false;
+    }
+
+    // [Unit-test:12] Check that deferred frees are allocated blocks inside the heap, the
+    // small ones on the stack of their size and region, and that pending_n counts them
+    size_t pending_total = pending_large;
+    for (size_t i = 0; i < pending_large; i++) {
+        if (!in_heap(pending[i]) || !fetch_alloc(header_ptr(pending[i])) ||
+            (fetch_size(header_ptr(pending[i])) <= QUICK_GRANULES * ALIGNMENT)) {
+            dbg_printf("Bad deferred free %p\n", pending[i]);
+            return false;
+        }
+    }
+    for (int reg = 0; reg < REGIONS; reg++) {
+        for (size_t gran = 0; gran <= QUICK_GRANULES; gran++) {
+            for (block_ptr = pending_head[reg][gran]; block_ptr != NULL; block_ptr = get_pred(block_ptr)) {
+                if (!in_heap(block_ptr) || !fetch_alloc(header_ptr(block_ptr)) ||
+                    (fetch_size(header_ptr(block_ptr)) != gran * ALIGNMENT) ||
+                    ((read_region_tag(header_ptr(block_ptr)) != 0) != (reg == 1)) ||
+                    (++pending_total > pending_n)) {
+                    dbg_printf("Bad deferred free %p\n", block_ptr);
+                    return false;
+                }
+            }
+        }
+    }
+    if (pending_total != pending_n) {
+        dbg_printf("%zu deferred frees, pending_n is %zu\n", pending_total, pending_n);
+        return false;
+    }
+
+    // [Unit-test:13] Check that the seg lists hold free blocks, by address in MM_ORDER_ADDRESS
+    for (int lst = 0; lst < REGIONS * SEGLIST_SIZE; lst++) {
+        list_iter_t it;
+        char *prev = NULL;
+        for (block_ptr = list_first(&it, lst); block_ptr != NULL; block_ptr = list_next(&it, block_ptr)) {
+            if (fetch_alloc(header_ptr(block_ptr)) ||
+                ((conf.order == MM_ORDER_ADDRESS) && (block_ptr <= prev))) {
+                dbg_printf("Bad block %p on seg list %d\n", block_ptr, lst);
+                return false;
+            }
+            prev = block_ptr;
+        }
+    }
+
+    // [Unit-test:14] Check that the inline bins hold allocated blocks of at least their size,
+    // as many as they count, and that they are closed while the lock is on
+    for (int bin = 0; bin < MM_INLINE_BINS; bin++) {
+        unsigned count = 0;
+        for (block_ptr = mm_inline_bins[bin].head; block_ptr != NULL; block_ptr = *(void **) block_ptr) {
+            if (!in_heap(block_ptr) || !fetch_alloc(header_ptr(block_ptr)) ||
+                (fetch_size(header_ptr(block_ptr)) < (size_t) bin * ALIGNMENT) ||
+                (++count > mm_inline_bins[bin].count)) {
+                dbg_printf("Bad block %p in inline bin %d\n", block_ptr, bin);
+                return false;
+            }
+        }
+        if (conf.lock ? ((count != 0) || (mm_inline_bins[bin].count != MM_INLINE_DEPTH))
+                      : (count != mm_inline_bins[bin].count)) {
+            dbg_printf("Inline bin %d holds %u blocks, counts %u\n", bin, count, mm_inline_bins[bin].count);
+            return false;
+        }
+    }
 
     #endif /* DEBUG */
     
@@ -1,3 +1,6 @@
+#ifndef MM_H_
+#define MM_H_
+
 #include <stdio.h>
 #include <stdbool.h>
 
@@ -8,6 +11,13 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 extern void *mm_calloc (size_t nmemb, size_t size);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern int mm_posix_memalign(void **memptr, size_t alignment, size_t size);
+extern void *mm_aligned_alloc(size_t alignment, size_t size);
+extern void *mm_valloc(size_t size);
+extern void *mm_pvalloc(size_t size);
+extern void *mm_reallocarray(void *ptr, size_t nmemb, size_t size);
+extern size_t mm_malloc_usable_size(void *ptr);
 
 #else
 
@@ -16,10 +26,97 @@ extern void *malloc (size_t size);
 extern void free (void *ptr);
 extern void *realloc(void *ptr, size_t size);
 extern void *calloc (size_t nmemb, size_t size);
+extern void *memalign(size_t alignment, size_t size);
+extern int posix_memalign(void **memptr, size_t alignment, size_t size);
+extern void *aligned_alloc(size_t alignment, size_t size);
+extern void *valloc(size_t size);
+extern void *pvalloc(size_t size);
+extern void *reallocarray(void *ptr, size_t nmemb, size_t size);
+extern size_t malloc_usable_size(void *ptr);
 
 #endif
 
 extern bool mm_init(void);
 
+/* Flags of mm_malloc_hint() */
+enum {
+    MM_HINT_SHORT = 1,  /* freed soon: served from the short-lived region */
+    MM_HINT_LONG = 2,   /* long-lived: served like plain malloc */
+    MM_FLAG_CACHELINE = 4  /* cache-line aligned, padded to whole lines */
+};
+
+/* malloc with a lifetime hint; realloc keeps a block in its region, but
+   not its cache-line alignment */
+extern void *mm_malloc_hint(size_t size, int flags);
+
+/* Bins of the inline fast path (mm_inline.h): freed blocks for requests
+   of up to MM_INLINE_MAX bytes, by block size in 16-byte granules.  The
+   blocks stay allocated as far as the heap is concerned; a bin holds at
+   most MM_INLINE_DEPTH of them and is emptied before the heap grows.
+   While MM_CFG_LOCK is on the bins are kept empty and full, so the fast
+   path always falls through to the locked malloc and free. */
+#define MM_INLINE_MAX 128
+#define MM_INLINE_DEPTH 64
+#define MM_INLINE_BINS ((MM_INLINE_MAX + 31) / 16 + 1)
+
+typedef struct {
+    void *head;             /* linked through the first payload word */
+    unsigned count;
+} mm_inline_bin_t;
+
+extern mm_inline_bin_t mm_inline_bins[MM_INLINE_BINS];
+
+/* Tuning parameters for mm_config() */
+typedef enum {
+    MM_CFG_FIT,         /* placement policy, an mm_fit_t */
+    MM_CFG_SPLIT,       /* which end of a split free block is handed out, an mm_split_t */
+    MM_CFG_SPLIT_LIMIT, /* MM_SPLIT_SIZE: blocks of at least this many bytes go high */
+    MM_CFG_GOOD_N,      /* MM_FIT_GOOD: fitting blocks examined per size class */
+    MM_CFG_QUICK_BYTES, /* bytes kept on the exact-size quick lists; 0 disables them */
+    MM_CFG_DEFER,       /* frees buffered before one batched coalescing pass; 0 disables */
+    MM_CFG_ORDER,       /* order of the blocks of a size class, an mm_order_t */
+    MM_CFG_THREAD_LINES, /* nonzero: a thread's first malloc after another thread's
+                            is cache-line aligned and padded, so consecutive
+                            allocations by different threads are on separate
+                            lines (other objects may still share one) */
+    MM_CFG_PREFETCH,    /* free blocks a seg list search prefetches ahead, 0 (default)..2 */
+    MM_CFG_LOCK         /* nonzero: one mutex serializes malloc, free, realloc, calloc
+                           and mm_malloc_hint, so threads may share the heap (the
+                           inline fast path of mm_inline.h is then bypassed) */
+} mm_param_t;
+
+/* Free-list orders */
+typedef enum {
+    MM_ORDER_LIFO,      /* most recently freed block first */
+    MM_ORDER_ADDRESS    /* lowest address first (treap, O(log n) insertion) */
+} mm_order_t;
+
+/* Placement policies */
+typedef enum {
+    MM_FIT_FIRST,       /* first fitting block of the size class */
+    MM_FIT_NEXT,        /* first fit, resuming where the last search stopped */
+    MM_FIT_BEST,        /* smallest fitting block of the size class */
+    MM_FIT_GOOD         /* smallest of the first MM_CFG_GOOD_N fitting blocks */
+} mm_fit_t;
+
+/* Split directions */
+typedef enum {
+    MM_SPLIT_SIZE,      /* large blocks at the high end, small ones at the low end */
+    MM_SPLIT_LOW,       /* always at the low end */
+    MM_SPLIT_HIGH       /* always at the high end */
+} mm_split_t;
+
+/* Set a tuning parameter; it takes effect at the next mm_init().
+   Returns false if the parameter or value is invalid. */
+extern bool mm_config(mm_param_t param, long value);
+
+/* Apply comma separated "key=value" settings (keys fit, split,
+   split_limit, good_n, quick, defer, order, thread_lines, prefetch, lock), e.g. "fit=best,split=low".  The MM_CONFIG
+   environment variable is applied the same way before the first
+   mm_config() or mm_init() call. */
+extern bool mm_config_parse(const char *spec);
+
 /* This is for debugging.  Returns false if error encountered */
 extern bool mm_checkheap(int lineno);
+
+#endif /* MM_H_ */
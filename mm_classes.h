@@ -0,0 +1,45 @@
+/*
+ * mm_classes.h - size classes of the mm.c seg lists
+ *
+ * Power-of-two classes: class k holds blocks of [2^k, 2^(k+1)) bytes.
+ *
+ * Generated by mkclasses; do not edit.
+ */
+#ifndef MM_CLASSES_H_
+#define MM_CLASSES_H_
+
+#define SEGLIST_SIZE 20
+
+/* Block sizes up to CLASS_LUT_MAX bytes: class is class_lut[size / 16] */
+#define CLASS_LUT_MAX 4096
+
+static const unsigned char class_lut[CLASS_LUT_MAX / 16 + 1] = {
+     0,  4,  5,  5,  6,  6,  6,  6,  7,  7,  7,  7,  7,  7,  7,  7,
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+     9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,
+     9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    12,
+};
+
+/* Class i holds block sizes in (class_limit[i-1], class_limit[i]] */
+static const size_t class_limit[SEGLIST_SIZE] = {
+    1, 3, 7, 15,
+    31, 63, 127, 255,
+    511, 1023, 2047, 4095,
+    8191, 16383, 32767, 65535,
+    131071, 262143, 524287, SIZE_MAX
+};
+
+#endif /* MM_CLASSES_H_ */
@@ -0,0 +1,56 @@
+/*
+ * mm_inline.h - Inline fast path for small fixed-size malloc/free
+ *
+ * mm_malloc_inline() and mm_free_inline() are for call sites whose
+ * size is a compile-time constant, typically sizeof of a struct.  For
+ * such sizes up to MM_INLINE_MAX bytes the bin is picked at compile
+ * time and a request is a pop from (a free a push onto) that bin, with
+ * no call into mm.c.  Other sizes, empty bins and full bins take the
+ * normal out-of-line path.
+ *
+ * mm_free_inline() must be passed the size the block was allocated
+ * with.  Blocks from either path can be freed with either function.
+ */
+#include "mm.h"
+
+/* Bin of a constant request size; 0 for sizes the bins don't serve */
+static inline __attribute__((always_inline)) unsigned mm_inline_bin(size_t size)
+{
+    if (!__builtin_constant_p(size) || (size == 0) || (size > MM_INLINE_MAX))
+        return 0;
+    return (unsigned) ((size + 31) / 16);     /* block size in granules */
+}
+
+static inline __attribute__((always_inline)) void *mm_malloc_inline(size_t size)
+{
+    unsigned bin = mm_inline_bin(size);
+    void *ptr;
+
+    if ((bin != 0) && ((ptr = mm_inline_bins[bin].head) != NULL)) {
+        mm_inline_bins[bin].head = *(void **) ptr;
+        mm_inline_bins[bin].count--;
+        return ptr;
+    }
+#ifdef DRIVER
+    return mm_malloc(size);
+#else
+    return malloc(size);
+#endif
+}
+
+static inline __attribute__((always_inline)) void mm_free_inline(void *ptr, size_t size)
+{
+    unsigned bin = mm_inline_bin(size);
+
+    if ((bin != 0) && (ptr != NULL) && (mm_inline_bins[bin].count < MM_INLINE_DEPTH)) {
+        *(void **) ptr = mm_inline_bins[bin].head;
+        mm_inline_bins[bin].head = ptr;
+        mm_inline_bins[bin].count++;
+        return;
+    }
+#ifdef DRIVER
+    mm_free(ptr);
+#else
+    free(ptr);
+#endif
+}
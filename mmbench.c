@@ -0,0 +1,711 @@
+/*
+ * mmbench.c - Microbenchmarks for the malloc lab support code and
+ *             the mm.c allocator.
+ *
+ * Each benchmark is a function that prints its own small table.
+ * Timing is done with fsec() from fcyc.c, so the usual K-best
+ * convergence rules apply to every number reported here; only the
+ * multithreaded falseshare benchmark times wall-clock runs itself.
+ *
+ * Usage: mmbench [-h] [-o <offset>] [bench ...]
+ *        With no bench names, every benchmark is run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "mm_inline.h"
+#include "arena.h"
+#include "pool.h"
+#include "memlib.h"
+#include "fcyc.h"
+#include "config.h"
+
+/* Misalignment (in bytes) applied to buffers of the copy benchmark */
+static size_t misalign = 0;
+
+/* A single benchmark */
+typedef struct {
+    const char *name;
+    const char *descr;
+    void (*run)(void);
+} bench_t;
+
+static void bench_copy(void);
+static void bench_arena(void);
+static void bench_pool(void);
+static void bench_falseshare(void);
+static void bench_prefetch(void);
+static void bench_inline(void);
+
+static bench_t benches[] = {
+    { "copy", "mem_memcpy/mem_memset vs word loops vs libc", bench_copy },
+    { "arena", "request-style alloc-then-free-all: malloc/free vs arena", bench_arena },
+    { "pool", "identical node structs: malloc/free vs a fixed-size pool", bench_pool },
+    { "falseshare", "per-thread counters: malloc vs cache-line placement", bench_falseshare },
+    { "prefetch", "cold seg list searches on a heap above the LLC, by prefetch distance", bench_prefetch },
+    { "inline", "fixed-size structs: mm_malloc/mm_free vs the mm_inline.h fast path", bench_inline },
+    { NULL, NULL, NULL }
+};
+
+/*************************************************
+ * copy: mem_memcpy and mem_memset against the old
+ * word-at-a-time loops and the libc versions
+ *************************************************/
+
+typedef void *(*copy_fun_t)(void *dst, const void *src, size_t n);
+typedef void *(*set_fun_t)(void *dst, int c, size_t n);
+
+typedef struct {
+    copy_fun_t copy;
+    set_fun_t set;
+    unsigned char *dst;
+    unsigned char *src;
+    size_t n;
+} copy_args_t;
+
+static void run_copy(void *p) {
+    copy_args_t *a = p;
+    a->copy(a->dst, a->src, a->n);
+}
+
+static void run_set(void *p) {
+    copy_args_t *a = p;
+    a->set(a->dst, 0x5a, a->n);
+}
+
+/* Print the throughput in GB/s of one copy or set function */
+static void time_copy(copy_args_t *a, bool set) {
+    double secs = fsec(set ? run_set : run_copy, a);
+    printf("%10.2f", (secs > 0.0) ? (double) a->n / secs * 1e-9 : 0.0);
+}
+
+static void bench_copy(void) {
+    size_t max_bytes = 1ul << 26;
+    int c;
+    void *src, *dst;
+    if (posix_memalign(&src, 64, max_bytes + 64) != 0 ||
+        posix_memalign(&dst, 64, max_bytes + 64) != 0) {
+        fprintf(stderr, "bench_copy: out of memory\n");
+        exit(1);
+    }
+    memset(src, 0x11, max_bytes + 64);
+    memset(dst, 0x22, max_bytes + 64);
+
+    copy_args_t a;
+    a.src = (unsigned char *) src + misalign;
+    a.dst = (unsigned char *) dst + misalign;
+
+    /* Warm up the vector units, so the small sizes aren't timed while
+       the wide datapath is still powering up */
+    for (c = 0; c < 100000; c++) {
+        mem_memcpy(a.dst, a.src, 4096);
+        mem_memset(a.dst, c, 4096);
+    }
+
+    printf("GB/s, buffers misaligned by %zu bytes, non-temporal from %lu bytes\n",
+           misalign, (unsigned long) MEM_NT_BYTES);
+    printf("%10s %10s%10s%10s   %10s%10s%10s\n", "bytes",
+           "cpy-words", "cpy-vec", "cpy-libc", "set-words", "set-vec", "set-libc");
+    for (a.n = 16; a.n <= max_bytes; a.n <<= 2) {
+        printf("%10zu ", a.n);
+        a.copy = mem_memcpy_words;
+        time_copy(&a, false);
+        a.copy = mem_memcpy;
+        time_copy(&a, false);
+        a.copy = memcpy;
+        time_copy(&a, false);
+        printf("   ");
+        a.set = mem_memset_words;
+        time_copy(&a, true);
+        a.set = mem_memset;
+        time_copy(&a, true);
+        a.set = memset;
+        time_copy(&a, true);
+        printf("\n");
+    }
+
+    free(src);
+    free(dst);
+}
+
+/*************************************************
+ * arena: a request allocates n small objects and
+ * drops them all at its end, with mm_malloc and
+ * mm_free or with an arena and one reset
+ *************************************************/
+
+/* Requests per timed run of the arena benchmark */
+#define ARENA_REQUESTS 16
+
+typedef struct {
+    size_t n;                 /* objects per request */
+    size_t *sizes;            /* their sizes, 16..256 bytes */
+    void **ptrs;
+    mm_arena_t *arena;
+} arena_args_t;
+
+static void run_request_malloc(void *p) {
+    arena_args_t *a = p;
+    size_t i;
+    int r;
+    for (r = 0; r < ARENA_REQUESTS; r++) {
+        for (i = 0; i < a->n; i++) {
+            a->ptrs[i] = mm_malloc(a->sizes[i]);
+            *(char *) a->ptrs[i] = (char) i;
+        }
+        for (i = 0; i < a->n; i++)
+            mm_free(a->ptrs[i]);
+    }
+}
+
+static void run_request_arena(void *p) {
+    arena_args_t *a = p;
+    size_t i;
+    int r;
+    for (r = 0; r < ARENA_REQUESTS; r++) {
+        for (i = 0; i < a->n; i++) {
+            a->ptrs[i] = mm_arena_alloc(a->arena, a->sizes[i]);
+            *(char *) a->ptrs[i] = (char) i;
+        }
+        mm_arena_reset(a->arena);
+    }
+}
+
+static void bench_arena(void) {
+    size_t max_n = 1 << 16;
+    arena_args_t a;
+    size_t i;
+
+    a.sizes = malloc(max_n * sizeof(size_t));
+    a.ptrs = malloc(max_n * sizeof(void *));
+    if (a.sizes == NULL || a.ptrs == NULL) {
+        fprintf(stderr, "bench_arena: out of memory\n");
+        exit(1);
+    }
+    srand(1);
+    for (i = 0; i < max_n; i++)
+        a.sizes[i] = 16 + (size_t) (rand() % 241);
+
+    mem_init();
+    printf("ns per object, %d requests per run\n", ARENA_REQUESTS);
+    printf("%10s %10s %10s %10s\n", "objects", "malloc", "arena", "speedup");
+    for (a.n = 16; a.n <= max_n; a.n <<= 2) {
+        double ops = (double) a.n * ARENA_REQUESTS;
+        double t_malloc, t_arena;
+
+        mem_reset_brk();
+        if (!mm_init()) {
+            fprintf(stderr, "bench_arena: mm_init failed\n");
+            exit(1);
+        }
+        t_malloc = fsec(run_request_malloc, &a);
+
+        mem_reset_brk();
+        if (!mm_init() || (a.arena = mm_arena_create()) == NULL) {
+            fprintf(stderr, "bench_arena: mm_init failed\n");
+            exit(1);
+        }
+        t_arena = fsec(run_request_arena, &a);
+        mm_arena_destroy(a.arena);
+
+        printf("%10zu %10.2f %10.2f %9.1fx\n", a.n, t_malloc / ops * 1e9,
+               t_arena / ops * 1e9, t_arena > 0.0 ? t_malloc / t_arena : 0.0);
+    }
+    mem_deinit();
+    free(a.sizes);
+    free(a.ptrs);
+}
+
+/*************************************************
+ * pool: build a graph of n identical node structs,
+ * churn half of them in random order and drop it,
+ * with mm_malloc/mm_free or with a pool
+ *************************************************/
+
+/* Size of a node struct, as allocated in the bdd-* traces */
+#define POOL_NODE 24
+
+typedef struct {
+    size_t n;                 /* nodes */
+    size_t *order;            /* random permutation of 0..n-1 */
+    void **ptrs;
+    mm_pool_t *pool;
+    bool use_pool;
+} pool_args_t;
+
+static inline void *node_alloc(pool_args_t *a) {
+    return a->use_pool ? mm_pool_alloc(a->pool) : mm_malloc(POOL_NODE);
+}
+
+static inline void node_free(pool_args_t *a, void *p) {
+    if (a->use_pool)
+        mm_pool_free(a->pool, p);
+    else
+        mm_free(p);
+}
+
+static void run_pool(void *p) {
+    pool_args_t *a = p;
+    size_t i;
+    for (i = 0; i < a->n; i++) {
+        a->ptrs[i] = node_alloc(a);
+        *(size_t *) a->ptrs[i] = i;
+    }
+    for (i = 0; i < a->n / 2; i++)
+        node_free(a, a->ptrs[a->order[i]]);
+    for (i = 0; i < a->n / 2; i++)
+        a->ptrs[a->order[i]] = node_alloc(a);
+    for (i = 0; i < a->n; i++)
+        node_free(a, a->ptrs[a->order[i]]);
+}
+
+static void bench_pool(void) {
+    size_t max_n = 1 << 20;
+    pool_args_t a;
+    mm_pool_stats_t st;
+    size_t i;
+
+    a.order = malloc(max_n * sizeof(size_t));
+    a.ptrs = malloc(max_n * sizeof(void *));
+    if (a.order == NULL || a.ptrs == NULL) {
+        fprintf(stderr, "bench_pool: out of memory\n");
+        exit(1);
+    }
+
+    mem_init();
+    printf("%d-byte nodes: ns per alloc/free pair, heap bytes per node\n", POOL_NODE);
+    printf("%10s %10s %10s %12s %12s\n", "nodes", "malloc", "pool", "malloc B/n", "pool B/n");
+    for (a.n = 1 << 10; a.n <= max_n; a.n <<= 2) {
+        double pairs = 1.5 * a.n;
+        double t_malloc, t_pool;
+        size_t heap_malloc, heap_pool;
+
+        srand(1);
+        for (i = 0; i < a.n; i++)
+            a.order[i] = i;
+        for (i = a.n - 1; i > 0; i--) {
+            size_t j = (size_t) rand() % (i + 1), t = a.order[i];
+            a.order[i] = a.order[j];
+            a.order[j] = t;
+        }
+
+        mem_reset_brk();
+        if (!mm_init()) {
+            fprintf(stderr, "bench_pool: mm_init failed\n");
+            exit(1);
+        }
+        a.use_pool = false;
+        t_malloc = fsec(run_pool, &a);
+        heap_malloc = mem_heapsize();
+
+        mem_reset_brk();
+        if (!mm_init() || (a.pool = mm_pool_create(POOL_NODE, sizeof(void *))) == NULL) {
+            fprintf(stderr, "bench_pool: mm_init failed\n");
+            exit(1);
+        }
+        a.use_pool = true;
+        t_pool = fsec(run_pool, &a);
+        heap_pool = mem_heapsize();
+        mm_pool_stats(a.pool, &st);
+        mm_pool_destroy(a.pool);
+
+        printf("%10zu %10.2f %10.2f %12.1f %12.1f\n", a.n, t_malloc / pairs * 1e9,
+               t_pool / pairs * 1e9, (double) heap_malloc / a.n, (double) heap_pool / a.n);
+    }
+    printf("last pool: %zu-byte objects, %zu runs (%zu bytes), peak %zu in use, "
+           "%lu allocs, %lu frees\n", st.obj_size, st.runs, st.run_bytes,
+           st.peak_in_use, st.allocs, st.frees);
+    mem_deinit();
+    free(a.order);
+    free(a.ptrs);
+}
+
+/*************************************************
+ * falseshare: each thread allocates a counter and
+ * increments it; with plain malloc the counters of
+ * neighbouring threads share cache lines
+ *************************************************/
+
+/* Increments per thread and timed run, best of FALSE_RUNS runs */
+#define FALSE_INCS (1 << 24)
+#define FALSE_RUNS 3
+#define FALSE_MAX_THREADS 8
+#define CACHE_LINE 64
+
+typedef enum { FALSE_MALLOC, FALSE_CACHELINE, FALSE_THREAD_LINES } false_mode_t;
+
+typedef struct {
+    false_mode_t mode;
+    int threads;
+    volatile long *counters[FALSE_MAX_THREADS];
+    pthread_mutex_t lock;     /* mm.c is not thread-safe */
+    pthread_barrier_t start, done;
+} false_args_t;
+
+typedef struct {
+    false_args_t *a;
+    int id;
+} false_thread_t;
+
+static void *run_falseshare(void *p) {
+    false_thread_t *t = p;
+    false_args_t *a = t->a;
+    volatile long *c;
+    long i;
+
+    pthread_mutex_lock(&a->lock);
+    if (a->mode == FALSE_CACHELINE)
+        c = mm_malloc_hint(sizeof(long), MM_FLAG_CACHELINE);
+    else
+        c = mm_malloc(sizeof(long));
+    a->counters[t->id] = c;
+    pthread_mutex_unlock(&a->lock);
+    *c = 0;
+
+    pthread_barrier_wait(&a->start);
+    for (i = 0; i < FALSE_INCS; i++)
+        (*c)++;
+    pthread_barrier_wait(&a->done);
+    return NULL;
+}
+
+static double wall_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Best throughput in Mincs/s of one mode; *shared is set to the number
+   of counters that share their cache line with another counter */
+static double time_falseshare(false_args_t *a, int *shared) {
+    false_thread_t t[FALSE_MAX_THREADS];
+    pthread_t tid[FALSE_MAX_THREADS];
+    double best = 0.0;
+    int run, i, j;
+
+    for (run = 0; run < FALSE_RUNS; run++) {
+        double t0, secs;
+
+        mem_reset_brk();
+        if (!mm_config(MM_CFG_THREAD_LINES, a->mode == FALSE_THREAD_LINES) || !mm_init()) {
+            fprintf(stderr, "bench_falseshare: mm_init failed\n");
+            exit(1);
+        }
+        pthread_barrier_init(&a->start, NULL, a->threads + 1);
+        pthread_barrier_init(&a->done, NULL, a->threads + 1);
+        for (i = 0; i < a->threads; i++) {
+            t[i].a = a;
+            t[i].id = i;
+            if (pthread_create(&tid[i], NULL, run_falseshare, &t[i]) != 0) {
+                fprintf(stderr, "bench_falseshare: pthread_create failed\n");
+                exit(1);
+            }
+        }
+        pthread_barrier_wait(&a->start);
+        t0 = wall_sec();
+        pthread_barrier_wait(&a->done);
+        secs = wall_sec() - t0;
+        for (i = 0; i < a->threads; i++)
+            pthread_join(tid[i], NULL);
+        pthread_barrier_destroy(&a->start);
+        pthread_barrier_destroy(&a->done);
+
+        if (secs > 0.0 && (double) a->threads * FALSE_INCS / secs * 1e-6 > best)
+            best = (double) a->threads * FALSE_INCS / secs * 1e-6;
+    }
+
+    *shared = 0;
+    for (i = 0; i < a->threads; i++)
+        for (j = 0; j < a->threads; j++)
+            if (j != i && (uintptr_t) a->counters[i] / CACHE_LINE ==
+                (uintptr_t) a->counters[j] / CACHE_LINE) {
+                (*shared)++;
+                break;
+            }
+    return best;
+}
+
+static void bench_falseshare(void) {
+    static const char *const names[] = { "malloc", "cacheline", "thread_lines" };
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    false_args_t a;
+    int mode, shared;
+
+    pthread_mutex_init(&a.lock, NULL);
+    mem_init();
+    printf("M increments/s (wall clock, best of %d), counters sharing a line; %ld cpus\n",
+           FALSE_RUNS, cpus);
+    printf("%10s", "threads");
+    for (mode = FALSE_MALLOC; mode <= FALSE_THREAD_LINES; mode++)
+        printf(" %12s %6s", names[mode], "shared");
+    printf("\n");
+    for (a.threads = 2; a.threads <= FALSE_MAX_THREADS; a.threads <<= 1) {
+        printf("%10d", a.threads);
+        for (mode = FALSE_MALLOC; mode <= FALSE_THREAD_LINES; mode++) {
+            a.mode = mode;
+            double mops = time_falseshare(&a, &shared);
+            printf(" %12.1f %6d", mops, shared);
+        }
+        printf("\n");
+    }
+    mm_config(MM_CFG_THREAD_LINES, 0);
+    mem_deinit();
+    pthread_mutex_destroy(&a.lock);
+}
+
+/*************************************************
+ * prefetch: best-fit searches through one long seg
+ * list of blocks scattered over a heap larger than
+ * the last-level cache, starting with a cold cache
+ *************************************************/
+
+/* Searched blocks are 1088..2032 bytes (one size class), one in
+   PREFETCH_SPREAD of them free, so list neighbours are far apart */
+#define PREFETCH_MIN 1088
+#define PREFETCH_SPREAD 2
+typedef struct {
+    size_t size;              /* request smaller than any free block */
+    const char *order;
+} prefetch_args_t;
+
+/* A search walks the whole list: best fit stops early only on an
+   exact match, and there is none.  The block found goes back at once. */
+static void run_prefetch(void *p) {
+    prefetch_args_t *a = p;
+    mm_free(mm_malloc(a->size));
+}
+
+static void bench_prefetch(void) {
+    static const char *const orders[] = { "lifo", "address" };
+    long llc = fcyc_cache_geometry()->llc;
+    size_t nodes, heap, i, max_nodes;
+    prefetch_args_t a;
+    void **ptrs;
+    int o, dist;
+    char spec[64];
+
+    /* enough blocks for a heap of twice the LLC */
+    max_nodes = 2 * (size_t) llc / ((PREFETCH_MIN + 2048) / 2);
+    ptrs = malloc(max_nodes * sizeof(void *));
+    if (ptrs == NULL) {
+        fprintf(stderr, "bench_prefetch: out of memory\n");
+        exit(1);
+    }
+
+    mem_init();
+    /* one search per sample, or all but the first would find the
+       list in the cache */
+    set_fcyc_min_reps(1);
+    set_fcyc_clear_cache(1);
+    printf("ns per free block visited, cache cleared (%ld KB) before each search\n", llc >> 10);
+    printf("%8s %10s %10s", "order", "blocks", "heap MB");
+    for (dist = 0; dist <= 2; dist++)
+        printf("  prefetch=%d", dist);
+    printf("\n");
+    for (o = 0; o < 2; o++) {
+        for (nodes = max_nodes / 64; nodes <= max_nodes; nodes *= 4) {
+            size_t free_nodes = (nodes + PREFETCH_SPREAD - 1) / PREFETCH_SPREAD;
+            a.order = orders[o];
+            printf("%8s %10zu", a.order, free_nodes);
+            for (dist = 0; dist <= 2; dist++) {
+                snprintf(spec, sizeof(spec), "order=%s,fit=best,quick=0,prefetch=%d", a.order, dist);
+                mem_reset_brk();
+                if (!mm_config_parse(spec) || !mm_init()) {
+                    fprintf(stderr, "bench_prefetch: mm_init failed\n");
+                    exit(1);
+                }
+                /* blocks in (PREFETCH_MIN, 2048) bytes, every
+                   PREFETCH_SPREAD-th one freed in random order */
+                srand(1);
+                for (i = 0; i < nodes; i++)
+                    ptrs[i] = mm_malloc(PREFETCH_MIN + (size_t) (rand() % 928));
+                for (i = 0; i < nodes; i += PREFETCH_SPREAD) {
+                    size_t j = i + (size_t) (rand() % ((nodes - i + PREFETCH_SPREAD - 1) / PREFETCH_SPREAD)) * PREFETCH_SPREAD;
+                    void *t = ptrs[i];
+                    ptrs[i] = ptrs[j];
+                    ptrs[j] = t;
+                    mm_free(ptrs[i]);
+                }
+                heap = mem_heapsize();
+                a.size = PREFETCH_MIN - 2 * sizeof(size_t);
+                if (dist == 0)
+                    printf(" %10.1f", (double) heap / (1 << 20));
+                printf(" %11.2f", fsec(run_prefetch, &a) / free_nodes * 1e9);
+            }
+            printf("\n");
+        }
+    }
+    mm_config_parse("order=lifo,fit=first,quick=65536,prefetch=0");
+    set_fcyc_min_reps(8);
+    set_fcyc_clear_cache(0);
+    mem_deinit();
+    free(ptrs);
+}
+
+/*************************************************
+ * inline: a hot loop allocates a batch of fixed-size
+ * structs and frees it, out of line or with the
+ * constant-size fast path of mm_inline.h
+ *************************************************/
+
+/* Structs live per batch, and batches per timed run */
+#define INLINE_BATCH 32
+#define INLINE_ROUNDS 256
+
+typedef struct { long key; void *left, *right; long val[3]; } inline_node_t;  /* 48 bytes */
+typedef struct { long key; void *next; } inline_pair_t;                       /* 16 bytes */
+
+static void *inline_ptrs[INLINE_BATCH];
+
+static void run_outline_node(void *p) {
+    int r, i;
+    for (r = 0; r < INLINE_ROUNDS; r++) {
+        for (i = 0; i < INLINE_BATCH; i++) {
+            inline_ptrs[i] = mm_malloc(sizeof(inline_node_t));
+            ((inline_node_t *) inline_ptrs[i])->key = i;
+        }
+        for (i = 0; i < INLINE_BATCH; i++)
+            mm_free(inline_ptrs[i]);
+    }
+}
+
+static void run_inline_node(void *p) {
+    int r, i;
+    for (r = 0; r < INLINE_ROUNDS; r++) {
+        for (i = 0; i < INLINE_BATCH; i++) {
+            inline_ptrs[i] = mm_malloc_inline(sizeof(inline_node_t));
+            ((inline_node_t *) inline_ptrs[i])->key = i;
+        }
+        for (i = 0; i < INLINE_BATCH; i++)
+            mm_free_inline(inline_ptrs[i], sizeof(inline_node_t));
+    }
+}
+
+static void run_outline_pair(void *p) {
+    int r, i;
+    for (r = 0; r < INLINE_ROUNDS; r++) {
+        for (i = 0; i < INLINE_BATCH; i++) {
+            inline_ptrs[i] = mm_malloc(sizeof(inline_pair_t));
+            ((inline_pair_t *) inline_ptrs[i])->key = i;
+        }
+        for (i = 0; i < INLINE_BATCH; i++)
+            mm_free(inline_ptrs[i]);
+    }
+}
+
+static void run_inline_pair(void *p) {
+    int r, i;
+    for (r = 0; r < INLINE_ROUNDS; r++) {
+        for (i = 0; i < INLINE_BATCH; i++) {
+            inline_ptrs[i] = mm_malloc_inline(sizeof(inline_pair_t));
+            ((inline_pair_t *) inline_ptrs[i])->key = i;
+        }
+        for (i = 0; i < INLINE_BATCH; i++)
+            mm_free_inline(inline_ptrs[i], sizeof(inline_pair_t));
+    }
+}
+
+static void bench_inline(void) {
+    static const struct {
+        const char *name;
+        size_t size;
+        test_funct outline, inlined;
+    } cases[] = {
+        { "node", sizeof(inline_node_t), run_outline_node, run_inline_node },
+        { "pair", sizeof(inline_pair_t), run_outline_pair, run_inline_pair },
+    };
+    double pairs = (double) INLINE_BATCH * INLINE_ROUNDS;
+    size_t c;
+
+    mem_init();
+    printf("ns per malloc/free pair, batches of %d structs\n", INLINE_BATCH);
+    printf("%10s %10s %10s %10s %10s\n", "struct", "bytes", "mm_malloc", "inline", "speedup");
+    for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        double t_out, t_in;
+
+        mem_reset_brk();
+        if (!mm_init()) {
+            fprintf(stderr, "bench_inline: mm_init failed\n");
+            exit(1);
+        }
+        t_out = fsec(cases[c].outline, NULL);
+
+        mem_reset_brk();
+        if (!mm_init()) {
+            fprintf(stderr, "bench_inline: mm_init failed\n");
+            exit(1);
+        }
+        t_in = fsec(cases[c].inlined, NULL);
+
+        printf("%10s %10zu %10.2f %10.2f %9.1fx\n", cases[c].name, cases[c].size,
+               t_out / pairs * 1e9, t_in / pairs * 1e9, t_in > 0.0 ? t_out / t_in : 0.0);
+    }
+    mem_deinit();
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(char *prog)
+{
+    int i;
+    fprintf(stderr, "Usage: %s [-h] [-o <offset>] [bench ...]\n", prog);
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-o <offset> Misalign copy buffers by <offset> bytes.\n");
+    fprintf(stderr, "Benchmarks\n");
+    for (i = 0; benches[i].name; i++)
+        fprintf(stderr, "\t%-10s %s\n", benches[i].name, benches[i].descr);
+}
+
+int main(int argc, char **argv)
+{
+    int c, i;
+
+    setbuf(stdout, 0);
+    while ((c = getopt(argc, argv, "ho:")) != EOF) {
+        switch (c) {
+            case 'o':
+                misalign = atoi(optarg) % 64;
+                break;
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    for (i = optind; i < argc; i++) {
+        int j;
+        for (j = 0; benches[j].name; j++)
+            if (strcmp(argv[i], benches[j].name) == 0)
+                break;
+        if (!benches[j].name) {
+            fprintf(stderr, "Unknown benchmark '%s'\n", argv[i]);
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    for (i = 0; benches[i].name; i++) {
+        bool selected = (optind == argc);
+        int j;
+        for (j = optind; j < argc; j++)
+            if (strcmp(argv[j], benches[i].name) == 0)
+                selected = true;
+        if (!selected)
+            continue;
+        printf("\n== %s: %s\n", benches[i].name, benches[i].descr);
+        benches[i].run();
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * mrep.c - Binary trace format, see mrep.h
+ */
+#include <string.h>
+#include "mrep.h"
+
+void mrep_init_header(mrep_header_t *h)
+{
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, MREP_MAGIC, sizeof(h->magic));
+    h->version = MREP_VERSION;
+}
+
+bool mrep_check_header(const mrep_header_t *h)
+{
+    return memcmp(h->magic, MREP_MAGIC, sizeof(h->magic)) == 0
+        && h->version == MREP_VERSION;
+}
+
+static size_t put_varint(unsigned char *buf, uint64_t v)
+{
+    size_t n = 0;
+
+    while (v >= 0x80) {
+        buf[n++] = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (unsigned char) v;
+    return n;
+}
+
+static const unsigned char *get_varint(const unsigned char *p, const unsigned char *end,
+                                       uint64_t *v)
+{
+    uint64_t val = 0;
+    int shift;
+
+    for (shift = 0; shift < 64; shift += 7) {
+        if (p == end)
+            return NULL;
+        val |= (uint64_t) (*p & 0x7f) << shift;
+        if ((*p++ & 0x80) == 0) {
+            *v = val;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+size_t mrep_encode_op(unsigned char *buf, const mrep_op_t *op, long *prev_index)
+{
+    int64_t delta = (int64_t) op->index - *prev_index;
+    uint64_t zigzag = ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63);
+    size_t n;
+
+    *prev_index = op->index;
+    n = put_varint(buf, zigzag << 2 | (uint64_t) op->type);
+    if (op->type != MREP_FREE)
+        n += put_varint(buf + n, op->size);
+    return n;
+}
+
+const unsigned char *mrep_decode_op(const unsigned char *p, const unsigned char *end,
+                                    mrep_op_t *op, long *prev_index)
+{
+    uint64_t v, zigzag, size = 0;
+
+    if ((p = get_varint(p, end, &v)) == NULL)
+        return NULL;
+    op->type = (int) (v & 3);
+    if (op->type > MREP_REALLOC)
+        return NULL;
+    zigzag = v >> 2;
+    *prev_index += (long) ((zigzag >> 1) ^ -(zigzag & 1));
+    op->index = *prev_index;
+    if (op->type != MREP_FREE && (p = get_varint(p, end, &size)) == NULL)
+        return NULL;
+    op->size = size;
+    return p;
+}
@@ -0,0 +1,67 @@
+/*
+ * mrep.h - Binary trace format
+ *
+ * A .mrep file holds the same requests as a .rep trace: a fixed
+ * header followed by one packed record per request.  A record starts
+ * with a varint holding the request type in its low two bits and,
+ * above them, the zigzag-encoded difference between its block id and
+ * that of the previous record; allocs and reallocs follow it with a
+ * varint of the size.  Most requests take two to four bytes.
+ *
+ * Multi-byte header fields are in host byte order.
+ */
+#ifndef MREP_H_
+#define MREP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MREP_MAGIC   "MREP"
+#define MREP_VERSION 1
+#define MREP_SUFFIX  ".mrep"
+
+/* Longest encoded record: two 10-byte varints */
+#define MREP_OP_MAX  20
+
+/* Request types, numbered as in mdriver's traceop_t */
+enum { MREP_ALLOC, MREP_FREE, MREP_REALLOC };
+
+typedef struct {
+    char magic[4];        /* MREP_MAGIC, not NUL terminated */
+    uint32_t version;     /* MREP_VERSION */
+    uint32_t weight;      /* as in the .rep header */
+    uint32_t num_ids;
+    uint64_t num_ops;
+    uint64_t data_bytes;
+    uint64_t body_bytes;  /* bytes of records after the header */
+} mrep_header_t;
+
+typedef struct {
+    int type;             /* MREP_ALLOC, MREP_FREE or MREP_REALLOC */
+    long index;           /* block id, -1 for free(NULL) */
+    size_t size;          /* alloc and realloc only */
+} mrep_op_t;
+
+/* Fill in the magic and version of a header */
+void mrep_init_header(mrep_header_t *h);
+
+/* Check the magic and version of a header */
+bool mrep_check_header(const mrep_header_t *h);
+
+/*
+ * Encode op into buf, which must have room for MREP_OP_MAX bytes.
+ * *prev_index is the block id of the previous record (0 before the
+ * first) and is updated.  Returns the number of bytes written.
+ */
+size_t mrep_encode_op(unsigned char *buf, const mrep_op_t *op, long *prev_index);
+
+/*
+ * Decode the record at p into op, reading no further than end.
+ * Returns the start of the next record, or NULL if the record is
+ * truncated or malformed.
+ */
+const unsigned char *mrep_decode_op(const unsigned char *p, const unsigned char *end,
+                                    mrep_op_t *op, long *prev_index);
+
+#endif /* MREP_H_ */
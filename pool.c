@@ -0,0 +1,158 @@
+/*
+ * pool.c - Pools of fixed-size objects on top of the mm.c heap
+ *
+ * Each page run starts with a header linking it to the previous run;
+ * objects follow at the first multiple of the pool's alignment.  New
+ * objects come from the free list first, else from the unused tail of
+ * the newest run, else from a new run.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mm.h"
+#include "pool.h"
+
+#ifdef DRIVER
+#define malloc mm_malloc
+#define free mm_free
+#endif
+
+#define POOL_PAGE (1<<12)
+#define POOL_RUN (1<<14)          /* default run size, in bytes */
+#define POOL_RUN_OBJS 16          /* a run holds at least this many objects */
+#define POOL_ALIGN 16             /* default object alignment */
+
+typedef struct pool_run {
+    struct pool_run *prev;        /* previously taken run */
+    size_t size;                  /* bytes of the run, header included */
+} pool_run_t;
+
+struct mm_pool {
+    size_t obj_size;
+    size_t align;
+    size_t run_size;
+    void *free_list;              /* freed objects, linked through their first word */
+    char *cur;                    /* next never-used object of the newest run */
+    char *end;                    /* end of the newest run */
+    pool_run_t *runs;             /* newest run, NULL if none */
+    size_t num_runs;
+    size_t num_free;              /* objects on free_list */
+    size_t in_use;
+    size_t peak_in_use;
+    unsigned long allocs;
+    unsigned long frees;
+};
+
+/* Take a new page run from the heap and make its objects available */
+static bool pool_grow(mm_pool_t *pool) {
+    pool_run_t *run;
+    uintptr_t first;
+
+    if ((run = malloc(pool->run_size)) == NULL)
+        return false;
+    run->prev = pool->runs;
+    run->size = pool->run_size;
+    pool->runs = run;
+    pool->num_runs++;
+
+    first = ((uintptr_t) (run + 1) + pool->align - 1) & ~(uintptr_t) (pool->align - 1);
+    pool->cur = (char *) first;
+    pool->end = (char *) run + run->size;
+    return true;
+}
+
+mm_pool_t *mm_pool_create(size_t obj_size, size_t align) {
+    mm_pool_t *pool;
+    size_t run_size;
+
+    if (align == 0)
+        align = POOL_ALIGN;
+    if ((align & (align - 1)) != 0 || align > POOL_PAGE || obj_size == 0 ||
+        obj_size > SIZE_MAX / (2 * POOL_RUN_OBJS))
+        return NULL;
+
+    /* room for the free-list link, and every object stays aligned */
+    if (obj_size < sizeof(void *))
+        obj_size = sizeof(void *);
+    if (align < sizeof(void *))
+        align = sizeof(void *);
+    obj_size = (obj_size + align - 1) & ~(align - 1);
+
+    /* whole pages, enough for the header, alignment slack and objects */
+    run_size = sizeof(pool_run_t) + align + POOL_RUN_OBJS * obj_size;
+    if (run_size < POOL_RUN)
+        run_size = POOL_RUN;
+    run_size = (run_size + POOL_PAGE - 1) & ~(size_t) (POOL_PAGE - 1);
+
+    if ((pool = malloc(sizeof(mm_pool_t))) == NULL)
+        return NULL;
+    pool->obj_size = obj_size;
+    pool->align = align;
+    pool->run_size = run_size;
+    pool->free_list = NULL;
+    pool->cur = NULL;
+    pool->end = NULL;
+    pool->runs = NULL;
+    pool->num_runs = 0;
+    pool->num_free = 0;
+    pool->in_use = 0;
+    pool->peak_in_use = 0;
+    pool->allocs = 0;
+    pool->frees = 0;
+    return pool;
+}
+
+void *mm_pool_alloc(mm_pool_t *pool) {
+    void *obj = pool->free_list;
+
+    if (obj != NULL) {
+        pool->free_list = *(void **) obj;
+        pool->num_free--;
+    } else {
+        if ((size_t) (pool->end - pool->cur) < pool->obj_size && !pool_grow(pool))
+            return NULL;
+        obj = pool->cur;
+        pool->cur += pool->obj_size;
+    }
+
+    pool->allocs++;
+    if (++pool->in_use > pool->peak_in_use)
+        pool->peak_in_use = pool->in_use;
+    return obj;
+}
+
+void mm_pool_free(mm_pool_t *pool, void *obj) {
+    if (obj == NULL)
+        return;
+    *(void **) obj = pool->free_list;
+    pool->free_list = obj;
+    pool->num_free++;
+    pool->in_use--;
+    pool->frees++;
+}
+
+void mm_pool_stats(const mm_pool_t *pool, mm_pool_stats_t *stats) {
+    stats->obj_size = pool->obj_size;
+    stats->runs = pool->num_runs;
+    stats->run_bytes = pool->num_runs * pool->run_size;
+    stats->in_use = pool->in_use;
+    stats->peak_in_use = pool->peak_in_use;
+    stats->free_objs = pool->num_free;
+    if (pool->end > pool->cur)
+        stats->free_objs += (size_t) (pool->end - pool->cur) / pool->obj_size;
+    stats->allocs = pool->allocs;
+    stats->frees = pool->frees;
+}
+
+void mm_pool_destroy(mm_pool_t *pool) {
+    pool_run_t *run, *prev;
+
+    if (pool == NULL)
+        return;
+    for (run = pool->runs; run != NULL; run = prev) {
+        prev = run->prev;
+        free(run);
+    }
+    free(pool);
+}
@@ -0,0 +1,40 @@
+/*
+ * pool.h - Pools of fixed-size objects on top of the mm.c heap
+ *
+ * A pool carves objects of one size out of page runs it takes from the
+ * heap with malloc.  Objects have no boundary tags; freed objects go on
+ * an intrusive singly linked free list.  Runs go back to the heap only
+ * when the pool is destroyed.
+ */
+#include <stddef.h>
+
+typedef struct mm_pool mm_pool_t;
+
+/* Usage statistics of a pool, see mm_pool_stats() */
+typedef struct {
+    size_t obj_size;        /* bytes per object, after rounding for alignment */
+    size_t runs;            /* page runs taken from the heap */
+    size_t run_bytes;       /* bytes of all page runs */
+    size_t in_use;          /* objects allocated and not freed */
+    size_t peak_in_use;     /* highest in_use so far */
+    size_t free_objs;       /* objects ready for reuse (free list and unused run tails) */
+    unsigned long allocs;   /* mm_pool_alloc calls that returned an object */
+    unsigned long frees;    /* mm_pool_free calls */
+} mm_pool_stats_t;
+
+/* Create a pool of obj_size-byte objects aligned to align bytes (a
+   power of two; 0 means 16).  Returns NULL on bad arguments or if out
+   of memory. */
+mm_pool_t *mm_pool_create(size_t obj_size, size_t align);
+
+/* Allocate one object; returns NULL if out of memory */
+void *mm_pool_alloc(mm_pool_t *pool);
+
+/* Return an object of this pool (NULL is ignored) */
+void mm_pool_free(mm_pool_t *pool, void *obj);
+
+/* Fill in the usage statistics of the pool */
+void mm_pool_stats(const mm_pool_t *pool, mm_pool_stats_t *stats);
+
+/* Free all objects, the page runs and the pool itself */
+void mm_pool_destroy(mm_pool_t *pool);
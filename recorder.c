@@ -0,0 +1,690 @@
+/*
+ * recorder.c - Record the allocation calls of a program as a .rep trace
+ *
+ * Built as librecord.so and loaded with LD_PRELOAD:
+ *
+ *     MM_RECORD=app.rep LD_PRELOAD=./librecord.so app args ...
+ *
+ * Every malloc, calloc, realloc, free and aligned allocation is passed
+ * on to the next allocator (normally libc's) and logged as an event in
+ * a ring buffer of the calling thread.  The rings have a single
+ * producer and a single consumer and need no locks.  A flusher thread
+ * empties them into a spill file next to the trace every millisecond.
+ * At exit the events are put in time order, block addresses are
+ * mapped to trace ids (the ids of freed blocks are reused, so there
+ * are about as many ids as blocks live at the peak) and the trace is
+ * written in the format read_trace() expects.
+ *
+ * Events are ordered by read_ticks() time stamps.  Allocations are
+ * stamped when the call returns and frees when it starts, so a block
+ * is always allocated before any thread frees it, and freed before
+ * its address is handed out again.  A realloc is stamped twice: the
+ * block passed in is released at the start of the call and the block
+ * returned appears at its end, as a free and an allocation would be.
+ * The trace still shows one realloc request, at the end of the call.
+ * This relies on the time stamp counters of all processors being
+ * synchronized, as they are on current x86 machines.
+ *
+ * Blocks still allocated at exit are freed at the end of the trace.
+ * Zero-byte allocations are written as 1-byte ones, since mdriver
+ * can't replay a request for 0 bytes, and a run without allocations
+ * writes no trace.
+ * The trace is only written if the program ends through exit(); after
+ * a crash the spill file (<trace>.raw) is left behind.  The spill file
+ * is only created once there are events to write, so a program that
+ * replaces itself with exec() before its first flush leaves nothing.
+ * Children of fork() are not recorded, and neither are programs it
+ * starts, unless the trace name contains "%p", which is replaced by
+ * the process id.
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "clock.h"
+#include "idmap.h"
+
+/* Events per thread ring (a power of two) */
+#define RING_EVENTS (1 << 14)
+/* Events the flusher collects before writing them out */
+#define SPILL_EVENTS 4096
+/* Interval of the flusher thread, in ns */
+#define FLUSH_NS 1000000
+/* Static memory for the allocations dlsym() makes before the real
+   functions are known */
+#define BOOT_BYTES (1 << 16)
+/* Environment variable naming the trace; default mmrecord.%p.rep */
+#define RECORD_ENV "MM_RECORD"
+#define RECORD_DEFAULT "mmrecord.%p.rep"
+
+/* In the order events with the same time stamp are sorted: blocks are
+   released before addresses are handed out */
+enum { EV_FREE, EV_RELEASE, EV_ALLOC, EV_REALLOC };
+
+/* The type is kept in the top bits of the size */
+#define TYPE_SHIFT 62
+#define SIZE_MASK ((1ull << TYPE_SHIFT) - 1)
+
+typedef struct {
+    uint64_t ts;
+    uint64_t ts0;             /* EV_REALLOC: time stamp of the call */
+    uintptr_t ptr;            /* block returned or freed */
+    uintptr_t old;            /* EV_REALLOC: block passed in */
+    uint64_t size;            /* size, and the type above TYPE_SHIFT */
+} event_t;
+
+typedef struct ring {
+    event_t ev[RING_EVENTS];
+    uint64_t head __attribute__((aligned(64)));  /* written by the owner */
+    uint64_t tail __attribute__((aligned(64)));  /* written by the flusher */
+    int live;                 /* owned by a running thread */
+    struct ring *next;        /* all rings, newest first */
+} ring_t;
+
+static void *(*real_malloc)(size_t);
+static void (*real_free)(void *);
+static void *(*real_realloc)(void *, size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_memalign)(size_t, size_t);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+static void *(*real_aligned_alloc)(size_t, size_t);
+static void *(*real_valloc)(size_t);
+
+static unsigned char boot_heap[BOOT_BYTES] __attribute__((aligned(16)));
+static size_t boot_used;
+static bool resolving;
+
+static ring_t *rings;
+static int recording;
+static int stop_flusher;
+static pthread_t flusher;
+static pthread_key_t ring_key;
+static int spill_fd = -1;
+static event_t spill_buf[SPILL_EVENTS];
+static size_t spill_n;
+static char trace_path[PATH_MAX];
+static char spill_path[PATH_MAX + 8];
+
+static __thread ring_t *my_ring;
+static __thread int inside;   /* in the recorder itself: don't record */
+
+/*
+ * Bootstrap: look up the next allocator's functions.  dlsym() may
+ * allocate itself; those requests are served from boot_heap.
+ */
+static void resolve(void)
+{
+    if (resolving)
+        return;
+    resolving = true;
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_free = dlsym(RTLD_NEXT, "free");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_memalign = dlsym(RTLD_NEXT, "memalign");
+    real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+    real_aligned_alloc = dlsym(RTLD_NEXT, "aligned_alloc");
+    real_valloc = dlsym(RTLD_NEXT, "valloc");
+    resolving = false;
+}
+
+static void *boot_alloc(size_t size)
+{
+    void *p;
+
+    size = (size + 15) & ~(size_t) 15;
+    if (size > BOOT_BYTES - boot_used)
+        return NULL;
+    p = boot_heap + boot_used;
+    boot_used += size;
+    return p;
+}
+
+static inline bool in_boot(const void *p)
+{
+    return (const unsigned char *) p >= boot_heap &&
+        (const unsigned char *) p < boot_heap + BOOT_BYTES;
+}
+
+/*
+ * Rings
+ */
+static void ring_release(void *arg)
+{
+    ring_t *r = arg;
+
+    my_ring = NULL;
+    __atomic_store_n(&r->live, 0, __ATOMIC_RELEASE);
+}
+
+/* Give the calling thread a ring: a drained one of a finished thread,
+   or a new one */
+static ring_t *ring_attach(void)
+{
+    ring_t *r;
+
+    inside++;
+    for (r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r != NULL; r = r->next) {
+        int dead = 0;
+        if (__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == r->head &&
+            __atomic_compare_exchange_n(&r->live, &dead, 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+    if (r == NULL) {
+        r = mmap(NULL, sizeof(ring_t), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (r == MAP_FAILED) {
+            inside--;
+            return NULL;
+        }
+        r->live = 1;
+        r->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&rings, &r->next, r, true,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+    pthread_setspecific(ring_key, r);
+    my_ring = r;
+    inside--;
+    return r;
+}
+
+static void record(int type, void *ptr, void *old, size_t size, uint64_t ts0,
+                   uint64_t ts)
+{
+    ring_t *r = my_ring;
+    uint64_t head;
+    event_t *e;
+
+    if (r == NULL && (r = ring_attach()) == NULL)
+        return;
+    head = r->head;
+    /* Full: wait for the flusher rather than lose the event */
+    while (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == RING_EVENTS) {
+        if (!__atomic_load_n(&recording, __ATOMIC_RELAXED))
+            return;
+        sched_yield();
+    }
+    e = &r->ev[head & (RING_EVENTS - 1)];
+    e->ts = ts;
+    e->ts0 = ts0;
+    e->ptr = (uintptr_t) ptr;
+    e->old = (uintptr_t) old;
+    e->size = (size & SIZE_MASK) | (uint64_t) type << TYPE_SHIFT;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static inline bool recorded(void)
+{
+    return __atomic_load_n(&recording, __ATOMIC_RELAXED) && !inside;
+}
+
+/*
+ * Flusher
+ */
+/* Write out the collected events, creating the spill file on the first
+   call that has any */
+static void spill_flush(void)
+{
+    const char *p = (const char *) spill_buf;
+    size_t left = spill_n * sizeof(event_t);
+
+    if (left > 0 && spill_fd < 0 &&
+        (spill_fd = open(spill_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        fprintf(stderr, "recorder: could not create %s, not recording\n",
+                spill_path);
+        __atomic_store_n(&recording, 0, __ATOMIC_RELEASE);
+    }
+
+    while (left > 0) {
+        ssize_t n = write(spill_fd, p, left);
+        if (n <= 0)
+            break;
+        p += n;
+        left -= n;
+    }
+    spill_n = 0;
+}
+
+static void drain_rings(void)
+{
+    ring_t *r;
+
+    for (r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r != NULL; r = r->next) {
+        uint64_t tail = r->tail;
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+        while (tail != head) {
+            size_t pos = tail & (RING_EVENTS - 1);
+            size_t n = head - tail;
+            if (n > RING_EVENTS - pos)
+                n = RING_EVENTS - pos;
+            if (n > SPILL_EVENTS - spill_n)
+                n = SPILL_EVENTS - spill_n;
+            memcpy(&spill_buf[spill_n], &r->ev[pos], n * sizeof(event_t));
+            spill_n += n;
+            tail += n;
+            __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+            if (spill_n == SPILL_EVENTS)
+                spill_flush();
+        }
+    }
+    spill_flush();
+}
+
+static void *flush_loop(void *arg)
+{
+    struct timespec interval = { 0, FLUSH_NS };
+
+    inside = 1;
+    while (!__atomic_load_n(&stop_flusher, __ATOMIC_ACQUIRE)) {
+        nanosleep(&interval, NULL);
+        drain_rings();
+    }
+    drain_rings();
+    return NULL;
+}
+
+/*
+ * Writing the trace: the live blocks by address, with their ids and
+ * sizes, and the blocks of reallocs that are under way
+ */
+typedef struct {
+    idmap_t live;             /* address -> id and size */
+    idmap_t moving;           /* realloc_key() -> id and size */
+    long *free_ids;           /* stack of ids of freed blocks */
+    size_t num_free;
+    size_t free_cap;
+    long next_id;
+    size_t live_bytes;
+    size_t peak_bytes;
+    long ops;
+} id_state_t;
+
+/* A realloc is known by the block passed in and the time of the call */
+static inline uint64_t realloc_key(uintptr_t old, uint64_t ts0)
+{
+    return old ^ ts0;
+}
+
+static long id_take(id_state_t *s)
+{
+    return s->num_free > 0 ? s->free_ids[--s->num_free] : s->next_id++;
+}
+
+static void id_give(id_state_t *s, long id)
+{
+    if (s->num_free == s->free_cap) {
+        s->free_cap = s->free_cap ? 2 * s->free_cap : 1024;
+        s->free_ids = realloc(s->free_ids, s->free_cap * sizeof(long));
+    }
+    s->free_ids[s->num_free++] = id;
+}
+
+static void emit_free(id_state_t *s, FILE *out, uintptr_t ptr)
+{
+    idmap_slot_t *b = idmap_find(&s->live, ptr);
+
+    if (b->key == IDMAP_EMPTY)   /* allocated before recording started */
+        return;
+    if (out)
+        fprintf(out, "f %ld\n", (long) b->val);
+    s->ops++;
+    s->live_bytes -= b->size;
+    id_give(s, b->val);
+    idmap_remove(&s->live, b);
+}
+
+static void emit_alloc(id_state_t *s, FILE *out, uintptr_t ptr, size_t size)
+{
+    long id;
+
+    emit_free(s, out, ptr);   /* in case its free went unseen */
+    id = id_take(s);
+    idmap_put(&s->live, ptr, id, size);
+    if (out)
+        fprintf(out, "a %ld %zu\n", id, size);
+    s->ops++;
+    s->live_bytes += size;
+    if (s->live_bytes > s->peak_bytes)
+        s->peak_bytes = s->live_bytes;
+}
+
+/* Turn the sorted events into trace requests; only count them if out
+   is NULL */
+static void replay_events(const event_t *ev, size_t n, FILE *out, id_state_t *s)
+{
+    size_t i;
+
+    memset(s, 0, sizeof(*s));
+    idmap_init(&s->live, 10);
+    idmap_init(&s->moving, 4);
+
+    for (i = 0; i < n; i++) {
+        int type = ev[i].size >> TYPE_SHIFT;
+        size_t size = ev[i].size & SIZE_MASK;
+        uintptr_t ptr = ev[i].ptr, old = ev[i].old;
+        idmap_slot_t *b;
+        long id;
+
+        /* mm_malloc(0) returns NULL, which mdriver takes for a failure:
+           a block the program got for 0 bytes is replayed as 1 byte */
+        if (ptr != 0 && size == 0)
+            size = 1;
+
+        switch (type) {
+            case EV_ALLOC:
+                if (ptr != 0)
+                    emit_alloc(s, out, ptr, size);
+                break;
+            case EV_FREE:
+                if (ptr != 0)
+                    emit_free(s, out, ptr);
+                break;
+            case EV_RELEASE:   /* a realloc starts: its block is in flux */
+                b = idmap_find(&s->live, ptr);
+                if (b->key != IDMAP_EMPTY) {
+                    idmap_put(&s->moving, realloc_key(ptr, ev[i].ts),
+                              b->val, b->size);
+                    idmap_remove(&s->live, b);
+                }
+                break;
+            case EV_REALLOC:   /* and ends */
+                b = old ? idmap_find(&s->moving, realloc_key(old, ev[i].ts0)) : NULL;
+                if (b == NULL || b->key == IDMAP_EMPTY) {
+                    if (ptr != 0)   /* a malloc, or of an unknown block */
+                        emit_alloc(s, out, ptr, size);
+                    break;
+                }
+                id = b->val;
+                if (ptr != 0) {
+                    emit_free(s, out, ptr);   /* in case its free went unseen */
+                    idmap_put(&s->live, ptr, id, size);
+                    if (out)
+                        fprintf(out, "r %ld %zu\n", id, size);
+                    s->ops++;
+                    s->live_bytes += size - b->size;
+                    if (s->live_bytes > s->peak_bytes)
+                        s->peak_bytes = s->live_bytes;
+                } else if (size == 0) {   /* realloc(p, 0) freed p */
+                    if (out)
+                        fprintf(out, "f %ld\n", id);
+                    s->ops++;
+                    s->live_bytes -= b->size;
+                    id_give(s, id);
+                } else {                  /* failed, old is still there */
+                    idmap_put(&s->live, old, id, b->size);
+                }
+                idmap_remove(&s->moving, b);
+                break;
+        }
+    }
+
+    /* Like the bundled traces, end with every block freed */
+    for (i = 0; i < ((size_t) 1 << s->live.bits); i++) {
+        if (s->live.slots[i].key != IDMAP_EMPTY) {
+            if (out)
+                fprintf(out, "f %ld\n", (long) s->live.slots[i].val);
+            s->ops++;
+        }
+    }
+    idmap_destroy(&s->live);
+    idmap_destroy(&s->moving);
+    free(s->free_ids);
+}
+
+/* By time, and at the same time by type (see the event types) */
+static int event_cmp(const void *a, const void *b)
+{
+    const event_t *x = a, *y = b;
+
+    if (x->ts != y->ts)
+        return x->ts > y->ts ? 1 : -1;
+    return (x->size >> TYPE_SHIFT > y->size >> TYPE_SHIFT) -
+        (x->size >> TYPE_SHIFT < y->size >> TYPE_SHIFT);
+}
+
+static void write_trace(void)
+{
+    struct stat st;
+    event_t *ev;
+    size_t i, n, m, bytes;
+    id_state_t s;
+    FILE *out;
+    int fd;
+
+    if ((fd = open(spill_path, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+        return;
+    n = st.st_size / sizeof(event_t);
+    /* Room for the release at the start of every realloc */
+    bytes = (2 * n + 1) * sizeof(event_t);
+    ev = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ev == MAP_FAILED || pread(fd, ev, n * sizeof(event_t), 0) !=
+        (ssize_t) (n * sizeof(event_t))) {
+        fprintf(stderr, "recorder: could not read %s\n", spill_path);
+        close(fd);
+        return;
+    }
+    close(fd);
+    for (i = 0, m = n; i < n; i++) {
+        if (ev[i].size >> TYPE_SHIFT == EV_REALLOC && ev[i].old != 0) {
+            ev[m].ts = ev[i].ts0;
+            ev[m].ptr = ev[i].old;
+            ev[m].size = (uint64_t) EV_RELEASE << TYPE_SHIFT;
+            m++;
+        }
+    }
+    qsort(ev, m, sizeof(event_t), event_cmp);
+
+    replay_events(ev, m, NULL, &s);
+    if (s.next_id == 0) {     /* read_trace() needs at least one id */
+        fprintf(stderr, "recorder: no allocations, %s not written\n",
+                trace_path);
+        munmap(ev, bytes);
+        unlink(spill_path);
+        return;
+    }
+    if ((out = fopen(trace_path, "w")) == NULL) {
+        fprintf(stderr, "recorder: could not create %s\n", trace_path);
+        munmap(ev, bytes);
+        return;
+    }
+    fprintf(out, "1\n%ld\n%ld\n%zu\n", s.next_id, s.ops, s.peak_bytes);
+    replay_events(ev, m, out, &s);
+    fclose(out);
+    munmap(ev, bytes);
+    unlink(spill_path);
+    fprintf(stderr, "recorder: %ld requests, %ld ids written to %s\n",
+            s.ops, s.next_id, trace_path);
+}
+
+/*
+ * Start and end of recording
+ */
+static void fork_child(void)
+{
+    recording = 0;
+}
+
+__attribute__((constructor))
+static void recorder_start(void)
+{
+    const char *path = getenv(RECORD_ENV);
+    const char *pid_at;
+    size_t len;
+
+    if (real_malloc == NULL)
+        resolve();
+    if (path != NULL && *path == '\0')     /* a started program, see below */
+        return;
+    inside++;
+    if (path == NULL)
+        path = RECORD_DEFAULT;
+    if ((pid_at = strstr(path, "%p")) != NULL) {
+        len = pid_at - path;
+        snprintf(trace_path, sizeof(trace_path), "%.*s%d%s", (int) len, path,
+                 (int) getpid(), pid_at + 2);
+    } else {
+        snprintf(trace_path, sizeof(trace_path), "%s", path);
+        /* Programs started from here would write the same trace */
+        setenv(RECORD_ENV, "", 1);
+    }
+    snprintf(spill_path, sizeof(spill_path), "%s.raw", trace_path);
+    if (pthread_key_create(&ring_key, ring_release) != 0 ||
+        pthread_create(&flusher, NULL, flush_loop, NULL) != 0) {
+        fprintf(stderr, "recorder: could not start, not recording\n");
+        inside--;
+        return;
+    }
+    pthread_atfork(NULL, NULL, fork_child);
+    __atomic_store_n(&recording, 1, __ATOMIC_RELEASE);
+    inside--;
+}
+
+__attribute__((destructor))
+static void recorder_stop(void)
+{
+    if (!__atomic_load_n(&recording, __ATOMIC_ACQUIRE))
+        return;
+    inside++;
+    __atomic_store_n(&recording, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&stop_flusher, 1, __ATOMIC_RELEASE);
+    pthread_join(flusher, NULL);
+    if (spill_fd >= 0) {      /* else nothing was recorded */
+        close(spill_fd);
+        write_trace();
+    }
+    inside--;
+}
+
+/*
+ * The interposed functions
+ */
+void *malloc(size_t size)
+{
+    void *p;
+
+    if (real_malloc == NULL) {
+        resolve();
+        if (real_malloc == NULL)
+            return boot_alloc(size);
+    }
+    p = real_malloc(size);
+    if (recorded())
+        record(EV_ALLOC, p, NULL, size, 0, read_ticks());
+    return p;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (real_calloc == NULL) {
+        resolve();
+        if (real_calloc == NULL) {
+            if (nmemb != 0 && size > SIZE_MAX / nmemb)
+                return NULL;
+            return boot_alloc(nmemb * size);    /* static, so zero */
+        }
+    }
+    p = real_calloc(nmemb, size);
+    if (recorded())
+        record(EV_ALLOC, p, NULL, nmemb * size, 0, read_ticks());
+    return p;
+}
+
+void free(void *ptr)
+{
+    if (ptr == NULL || in_boot(ptr))
+        return;
+    if (real_free == NULL)
+        resolve();
+    if (recorded())
+        record(EV_FREE, ptr, NULL, 0, 0, read_ticks());
+    real_free(ptr);
+}
+
+void *realloc(void *old, size_t size)
+{
+    uint64_t ts0;
+    void *p;
+
+    if (in_boot(old)) {
+        size_t avail = boot_heap + BOOT_BYTES - (unsigned char *) old;
+        if ((p = malloc(size)) != NULL)
+            memcpy(p, old, size < avail ? size : avail);
+        return p;
+    }
+    if (real_realloc == NULL) {
+        resolve();
+        if (real_realloc == NULL)
+            return NULL;
+    }
+    ts0 = read_ticks();
+    p = real_realloc(old, size);
+    if (recorded())
+        record(EV_REALLOC, p, old, size, ts0, read_ticks());
+    return p;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    void *p;
+
+    if (real_memalign == NULL)
+        resolve();
+    p = real_memalign(alignment, size);
+    if (recorded())
+        record(EV_ALLOC, p, NULL, size, 0, read_ticks());
+    return p;
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    int err;
+
+    if (real_posix_memalign == NULL)
+        resolve();
+    err = real_posix_memalign(memptr, alignment, size);
+    if (err == 0 && recorded())
+        record(EV_ALLOC, *memptr, NULL, size, 0, read_ticks());
+    return err;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    void *p;
+
+    if (real_aligned_alloc == NULL)
+        resolve();
+    p = real_aligned_alloc(alignment, size);
+    if (recorded())
+        record(EV_ALLOC, p, NULL, size, 0, read_ticks());
+    return p;
+}
+
+void *valloc(size_t size)
+{
+    void *p;
+
+    if (real_valloc == NULL)
+        resolve();
+    p = real_valloc(size);
+    if (recorded())
+        record(EV_ALLOC, p, NULL, size, 0, read_ticks());
+    return p;
+}
@@ -0,0 +1,66 @@
+/*
+ * rectest.c - Allocation calls for make check-record
+ *
+ * Run under librecord.so: the trace it leaves must replay with
+ * mdriver -c.  Covers zero-byte requests (malloc(0), calloc(0, n),
+ * realloc(NULL, 0), realloc(p, 0)) next to ordinary ones, made by
+ * several threads.  With the argument "none" it allocates nothing, so
+ * no trace must be written.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THREADS 4
+#define ROUNDS 10000
+#define SLOTS 32
+
+static void *worker(void *arg)
+{
+    unsigned int seed = (unsigned int) (long) arg;
+    void *slot[SLOTS] = { NULL };
+    int i, k;
+
+    for (i = 0; i < ROUNDS; i++) {
+        k = rand_r(&seed) % SLOTS;
+        switch (rand_r(&seed) % 6) {
+            case 0:
+                free(slot[k]);
+                slot[k] = malloc(0);
+                break;
+            case 1:
+                free(slot[k]);
+                slot[k] = calloc(0, 8);
+                break;
+            case 2:
+                free(slot[k]);
+                slot[k] = realloc(NULL, 0);
+                break;
+            case 3:
+                slot[k] = realloc(slot[k], rand_r(&seed) % 4 ? rand_r(&seed) % 200 : 0);
+                break;
+            default:
+                free(slot[k]);
+                slot[k] = malloc(1 + rand_r(&seed) % 300);
+                break;
+        }
+    }
+    for (k = 0; k < SLOTS; k++)
+        free(slot[k]);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[THREADS];
+    long i;
+
+    if (argc > 1 && strcmp(argv[1], "none") == 0)
+        return 0;
+    for (i = 0; i < THREADS; i++)
+        if (pthread_create(&threads[i], NULL, worker, (void *) (i + 1)) != 0)
+            return 1;
+    for (i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+    return 0;
+}
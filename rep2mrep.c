@@ -0,0 +1,196 @@
+/*
+ * rep2mrep.c - Convert .rep traces to the binary .mrep format (mrep.h)
+ *
+ * Each trace is written next to it with the .rep suffix replaced by
+ * .mrep, or to the file given with -o.  With -r the conversion goes
+ * the other way, which makes it easy to check a round trip with diff.
+ *
+ * Usage: rep2mrep [-h] [-r] [-o <file>] trace ...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "mrep.h"
+
+static void app_error(const char *msg, const char *arg) {
+    fprintf(stderr, "rep2mrep: %s%s%s\n", msg, arg ? " " : "", arg ? arg : "");
+    exit(1);
+}
+
+/* Output name: name with its suffix from replaced by to */
+static char *out_name(const char *name, const char *from, const char *to) {
+    size_t len = strlen(name);
+    size_t flen = strlen(from);
+    char *out = malloc(len + strlen(to) + 1);
+
+    if (out == NULL)
+        app_error("out of memory for", name);
+    if (len >= flen && strcmp(name + len - flen, from) == 0)
+        len -= flen;
+    memcpy(out, name, len);
+    strcpy(out + len, to);
+    return out;
+}
+
+/* Convert text trace in to binary trace out; returns the bytes written */
+static long to_binary(const char *in, const char *out) {
+    FILE *f, *g;
+    mrep_header_t h;
+    int weight, num_ids, num_ops;
+    size_t data_bytes;
+    char type[2];
+    unsigned char buf[MREP_OP_MAX];
+    long prev_index = 0;
+    mrep_op_t op;
+    int i;
+
+    if ((f = fopen(in, "r")) == NULL)
+        app_error("could not open", in);
+    if (fscanf(f, "%d %d %d %zu", &weight, &num_ids, &num_ops, &data_bytes) != 4
+        || weight < 0 || num_ids < 0 || num_ops < 0)
+        app_error("bad header in", in);
+    if ((g = fopen(out, "w")) == NULL)
+        app_error("could not create", out);
+
+    mrep_init_header(&h);
+    h.weight = weight;
+    h.num_ids = num_ids;
+    h.num_ops = num_ops;
+    h.data_bytes = data_bytes;
+    /* body_bytes is filled in at the end */
+    if (fwrite(&h, sizeof(h), 1, g) != 1)
+        app_error("could not write", out);
+
+    for (i = 0; i < num_ops; i++) {
+        if (fscanf(f, "%1s", type) != 1)
+            app_error("too few requests in", in);
+        op.size = 0;
+        switch (type[0]) {
+            case 'a':
+            case 'r':
+                op.type = type[0] == 'a' ? MREP_ALLOC : MREP_REALLOC;
+                if (fscanf(f, "%ld %zu", &op.index, &op.size) != 2)
+                    app_error("bad request in", in);
+                break;
+            case 'f':
+                op.type = MREP_FREE;
+                if (fscanf(f, "%ld", &op.index) != 1)
+                    app_error("bad request in", in);
+                break;
+            default:
+                app_error("bad request type in", in);
+        }
+        size_t n = mrep_encode_op(buf, &op, &prev_index);
+        if (fwrite(buf, 1, n, g) != n)
+            app_error("could not write", out);
+        h.body_bytes += n;
+    }
+
+    if (fseek(g, 0, SEEK_SET) != 0 || fwrite(&h, sizeof(h), 1, g) != 1)
+        app_error("could not write", out);
+    fclose(f);
+    if (fclose(g) != 0)
+        app_error("could not write", out);
+    return sizeof(h) + h.body_bytes;
+}
+
+/* Convert binary trace in to text trace out; returns the bytes written */
+static long to_text(const char *in, const char *out) {
+    struct stat st;
+    const mrep_header_t *h;
+    const unsigned char *p, *end;
+    unsigned char *map;
+    long prev_index = 0;
+    mrep_op_t op;
+    uint64_t i;
+    FILE *g;
+    int fd;
+    long bytes;
+
+    if ((fd = open(in, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+        app_error("could not open", in);
+    if ((size_t) st.st_size < sizeof(mrep_header_t))
+        app_error("bad header in", in);
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        app_error("could not map", in);
+    close(fd);
+    h = (const mrep_header_t *) map;
+    if (!mrep_check_header(h) || h->body_bytes > st.st_size - sizeof(*h))
+        app_error("bad header in", in);
+    if ((g = fopen(out, "w")) == NULL)
+        app_error("could not create", out);
+
+    fprintf(g, "%u\n%u\n%lu\n%lu\n", h->weight, h->num_ids,
+            (unsigned long) h->num_ops, (unsigned long) h->data_bytes);
+    p = map + sizeof(*h);
+    end = p + h->body_bytes;
+    for (i = 0; i < h->num_ops; i++) {
+        if ((p = mrep_decode_op(p, end, &op, &prev_index)) == NULL)
+            app_error("bad request in", in);
+        if (op.type == MREP_FREE)
+            fprintf(g, "f %ld\n", op.index);
+        else
+            fprintf(g, "%c %ld %zu\n", op.type == MREP_ALLOC ? 'a' : 'r', op.index, op.size);
+    }
+    bytes = ftell(g);
+    munmap(map, st.st_size);
+    if (fclose(g) != 0)
+        app_error("could not write", out);
+    return bytes;
+}
+
+static void usage(char *prog) {
+    fprintf(stderr, "Usage: %s [-h] [-r] [-o <file>] trace ...\n", prog);
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-o <file>  Write the (single) converted trace to <file>.\n");
+    fprintf(stderr, "\t-r         Convert .mrep traces back to .rep.\n");
+}
+
+int main(int argc, char **argv) {
+    int c, i;
+    bool reverse = false;
+    char *outname = NULL;
+
+    while ((c = getopt(argc, argv, "ho:r")) != EOF) {
+        switch (c) {
+            case 'o':
+                outname = optarg;
+                break;
+            case 'r':
+                reverse = true;
+                break;
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+    if (optind == argc)
+        app_error("no trace files given", NULL);
+    if (outname && argc - optind > 1)
+        app_error("-o needs a single trace", NULL);
+
+    for (i = optind; i < argc; i++) {
+        struct stat st;
+        char *out = outname ? strdup(outname)
+            : reverse ? out_name(argv[i], MREP_SUFFIX, ".rep")
+            : out_name(argv[i], ".rep", MREP_SUFFIX);
+        long bytes = reverse ? to_text(argv[i], out) : to_binary(argv[i], out);
+
+        if (stat(argv[i], &st) == 0)
+            fprintf(stderr, "%s: %ld -> %ld bytes (%.1fx)\n", out,
+                    (long) st.st_size, bytes, (double) st.st_size / bytes);
+        free(out);
+    }
+    return 0;
+}
@@ -0,0 +1,530 @@
+/*
+ * tracegen.c - Generate synthetic .rep traces
+ *
+ * A trace is a sequence of phases, one per -p option.  Each phase makes
+ * n allocations with sizes and lifetimes drawn from its distributions;
+ * settings a phase does not give are kept from the one before.  Time
+ * counts allocations: a block with lifetime 100 is freed just before
+ * the 100th allocation after it.  Blocks that are still live at the
+ * end are freed in the order they are due, so that, like the bundled
+ * traces, every trace ends with an empty heap.
+ *
+ * Phase settings (comma separated, as in MM_CONFIG):
+ *   n=<count>        allocations in the phase
+ *   size=<dist>      request sizes in bytes
+ *   life=<dist>      lifetimes in allocations
+ *   realloc=<frac>   share of blocks that grow by realloc
+ *   grow=<factor>    size factor of each realloc
+ *   steps=<count>    reallocs of a growing block, spread over its life
+ *   peak=<bytes>     cap on the live payload bytes: to stay below it the
+ *                    blocks due soonest are freed early (0: no cap)
+ *
+ * Distributions:
+ *   fixed:<v>[/<v>...]      one of the values, each with weight 1, or
+ *                           with weight w if written as v*w
+ *   uniform:<lo>:<hi>       uniform between lo and hi
+ *   pow:<lo>:<hi>:<alpha>   power law between lo and hi, P(x) ~ x^-alpha
+ *   lognorm:<median>:<sigma> log-normal, sigma of the natural log
+ *   exp:<mean>              exponential
+ *   forever                 (life only) live until the end of the trace
+ * Numbers take the suffixes k, M and G (2^10, 2^20 and 2^30).
+ *
+ * -x <scale> multiplies counts, lifetimes and peaks, to get the same
+ * trace at a larger scale.  The output is reproducible for a seed (-s).
+ * For example, a mix similar to syn-mix.rep, at 10 times its size:
+ *
+ *   tracegen -x 10 -o big.rep -p n=40k,size=pow:8:24k:1.2,life=exp:2k
+ *
+ * Usage: tracegen [-h] [-o <file>] [-s <seed>] [-w <weight>] [-x <scale>]
+ *                 -p <phase> ...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <math.h>
+
+/* Most values in a fixed distribution */
+#define DIST_VALUES_MAX 32
+/* Most phases */
+#define PHASES_MAX 64
+/* Lifetime of forever blocks */
+#define FOREVER UINT64_MAX
+
+typedef enum {
+    DIST_FIXED, DIST_UNIFORM, DIST_POW, DIST_LOGNORM, DIST_EXP, DIST_FOREVER
+} dist_kind_t;
+
+typedef struct {
+    dist_kind_t kind;
+    double a, b, c;                     /* parameters, in the order given */
+    int nvals;                          /* fixed: values and their */
+    double vals[DIST_VALUES_MAX];       /* cumulative weights */
+    double cum[DIST_VALUES_MAX];
+} dist_t;
+
+typedef struct {
+    long n;
+    dist_t size;
+    dist_t life;
+    double realloc_frac;
+    double grow;
+    int steps;
+    double peak;
+} phase_t;
+
+/* A live block; the heap of them is ordered by due */
+typedef struct {
+    uint64_t due;               /* time of the next realloc or the free */
+    uint64_t interval;          /* time between reallocs */
+    double grow;                /* size factor of each realloc */
+    size_t size;
+    int id;
+    int steps_left;             /* reallocs still to come */
+} block_t;
+
+typedef struct {
+    block_t *b;
+    size_t n, cap;
+} heap_t;
+
+typedef struct {
+    FILE *out;                  /* NULL when only counting */
+    long ops;
+    long ids;
+    size_t live_bytes;
+    size_t peak_bytes;
+} gen_t;
+
+static phase_t phases[PHASES_MAX];
+static int num_phases;
+static double scale = 1.0;
+static uint64_t rng_state;
+
+static void app_error(const char *msg, const char *arg) {
+    fprintf(stderr, "tracegen: %s%s%s\n", msg, arg ? " " : "", arg ? arg : "");
+    exit(1);
+}
+
+/*
+ * Random numbers: splitmix64, so that traces don't depend on the libc
+ */
+static uint64_t rng_next(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* Uniform in [0, 1) */
+static double rng_unit(void) {
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Standard normal, by Box-Muller */
+static double rng_normal(void) {
+    double u = 1.0 - rng_unit();        /* (0, 1] for the log */
+
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * rng_unit());
+}
+
+static double dist_sample(const dist_t *d) {
+    double u, e;
+    int i;
+
+    switch (d->kind) {
+        case DIST_FIXED:
+            u = rng_unit() * d->cum[d->nvals - 1];
+            for (i = 0; i < d->nvals - 1 && u >= d->cum[i]; i++)
+                ;
+            return d->vals[i];
+        case DIST_UNIFORM:
+            return d->a + rng_unit() * (d->b - d->a);
+        case DIST_POW:
+            /* Inverse of the CDF of a Pareto cut off at lo and hi */
+            u = rng_unit();
+            if (fabs(d->c - 1.0) < 1e-9)
+                return d->a * pow(d->b / d->a, u);
+            e = 1.0 - d->c;
+            return pow(pow(d->a, e) + u * (pow(d->b, e) - pow(d->a, e)), 1.0 / e);
+        case DIST_LOGNORM:
+            return d->a * exp(d->b * rng_normal());
+        case DIST_EXP:
+            return -d->a * log(1.0 - rng_unit());
+        case DIST_FOREVER:
+            break;
+    }
+    return INFINITY;
+}
+
+/*
+ * Parsing of the phase settings
+ */
+
+/* Parse a number with an optional k, M or G suffix; returns its end */
+static const char *parse_number(const char *s, double *val) {
+    char *end;
+
+    *val = strtod(s, &end);
+    if (end == s)
+        return NULL;
+    switch (*end) {
+        case 'k': *val *= 1 << 10; end++; break;
+        case 'M': *val *= 1 << 20; end++; break;
+        case 'G': *val *= 1 << 30; end++; break;
+    }
+    return end;
+}
+
+/* Parse the number s..end exactly */
+static bool parse_value(const char *s, const char *end, double *val) {
+    return parse_number(s, val) == end && end > s;
+}
+
+/* Parse "<name>:p1:p2..." between s and end into d; false if bad */
+static bool parse_dist(const char *s, const char *end, dist_t *d, bool life) {
+    static const struct { const char *name; dist_kind_t kind; int params; } kinds[] = {
+        { "fixed", DIST_FIXED, 0 }, { "uniform", DIST_UNIFORM, 2 },
+        { "pow", DIST_POW, 3 }, { "lognorm", DIST_LOGNORM, 2 },
+        { "exp", DIST_EXP, 1 }, { "forever", DIST_FOREVER, 0 },
+    };
+    const char *colon = memchr(s, ':', end - s);
+    size_t nlen = (colon ? colon : end) - s;
+    double p[3] = { 0.0, 0.0, 0.0 };
+    int i, k;
+
+    for (k = 0; k < (int) (sizeof(kinds) / sizeof(kinds[0])); k++) {
+        if (strlen(kinds[k].name) == nlen && strncmp(s, kinds[k].name, nlen) == 0)
+            break;
+    }
+    if (k == (int) (sizeof(kinds) / sizeof(kinds[0])))
+        return false;
+    memset(d, 0, sizeof(*d));
+    d->kind = kinds[k].kind;
+
+    if (d->kind == DIST_FOREVER)
+        return life && colon == NULL;
+    if (colon == NULL)
+        return false;
+    s = colon + 1;
+
+    if (d->kind == DIST_FIXED) {
+        double total = 0.0, w;
+
+        while (s < end) {
+            const char *next = memchr(s, '/', end - s);
+            const char *star;
+            if (next == NULL)
+                next = end;
+            if (d->nvals == DIST_VALUES_MAX)
+                return false;
+            star = memchr(s, '*', next - s);
+            w = 1.0;
+            if (!parse_value(s, star ? star : next, &d->vals[d->nvals]) ||
+                (star && (!parse_value(star + 1, next, &w) || w <= 0.0)))
+                return false;
+            total += w;
+            d->cum[d->nvals++] = total;
+            s = next < end ? next + 1 : end;
+        }
+        return d->nvals > 0;
+    }
+
+    for (i = 0; i < kinds[k].params; i++) {
+        const char *next = memchr(s, ':', end - s);
+        if (next == NULL)
+            next = end;
+        if (!parse_value(s, next, &p[i]))
+            return false;
+        s = next < end ? next + 1 : end;
+        if (next == end) {
+            i++;
+            break;
+        }
+    }
+    if (i != kinds[k].params || s != end)
+        return false;
+    d->a = p[0];
+    d->b = kinds[k].params > 1 ? p[1] : 0.0;
+    d->c = kinds[k].params > 2 ? p[2] : 0.0;
+    switch (d->kind) {
+        case DIST_UNIFORM:
+            return d->a >= 0.0 && d->b >= d->a;
+        case DIST_POW:
+            return d->a > 0.0 && d->b >= d->a && d->c > 0.0;
+        case DIST_LOGNORM:
+            return d->a > 0.0 && d->b >= 0.0;
+        case DIST_EXP:
+            return d->a > 0.0;
+        default:
+            return true;
+    }
+}
+
+/* Apply comma separated 'key=value' settings to phase p; false if bad */
+static bool parse_phase(const char *spec, phase_t *p) {
+    while (*spec != '\0') {
+        const char *end = strchr(spec, ',');
+        const char *eq = strchr(spec, '=');
+        if (end == NULL)
+            end = spec + strlen(spec);
+        if (eq == NULL || eq > end)
+            return false;
+
+        size_t klen = eq - spec;
+        const char *val = eq + 1;
+        double num;
+        bool is_num = parse_value(val, end, &num);
+        bool ok;
+
+        if (klen == 1 && strncmp(spec, "n", 1) == 0)
+            ok = is_num && num >= 0 && (p->n = (long) num) == num;
+        else if (klen == 4 && strncmp(spec, "size", 4) == 0)
+            ok = parse_dist(val, end, &p->size, false);
+        else if (klen == 4 && strncmp(spec, "life", 4) == 0)
+            ok = parse_dist(val, end, &p->life, true);
+        else if (klen == 7 && strncmp(spec, "realloc", 7) == 0)
+            ok = is_num && num >= 0.0 && num <= 1.0 && (p->realloc_frac = num, true);
+        else if (klen == 4 && strncmp(spec, "grow", 4) == 0)
+            ok = is_num && num > 0.0 && (p->grow = num, true);
+        else if (klen == 5 && strncmp(spec, "steps", 5) == 0)
+            ok = is_num && num >= 0 && num <= 1 << 20 && (p->steps = (int) num, true);
+        else if (klen == 4 && strncmp(spec, "peak", 4) == 0)
+            ok = is_num && num >= 0.0 && (p->peak = num, true);
+        else
+            ok = false;
+        if (!ok)
+            return false;
+
+        spec = (*end == ',') ? end + 1 : end;
+    }
+    return true;
+}
+
+/*
+ * The heap of live blocks, a binary min-heap on due
+ */
+static void heap_push(heap_t *h, const block_t *b) {
+    size_t i;
+
+    if (h->n == h->cap) {
+        h->cap = h->cap ? 2 * h->cap : 1024;
+        if ((h->b = realloc(h->b, h->cap * sizeof(block_t))) == NULL)
+            app_error("out of memory", NULL);
+    }
+    for (i = h->n++; i > 0 && h->b[(i - 1) / 2].due > b->due; i = (i - 1) / 2)
+        h->b[i] = h->b[(i - 1) / 2];
+    h->b[i] = *b;
+}
+
+static block_t heap_pop(heap_t *h) {
+    block_t top = h->b[0];
+    block_t last = h->b[--h->n];
+    size_t i = 0, c;
+
+    while ((c = 2 * i + 1) < h->n) {
+        if (c + 1 < h->n && h->b[c + 1].due < h->b[c].due)
+            c++;
+        if (last.due <= h->b[c].due)
+            break;
+        h->b[i] = h->b[c];
+        i = c;
+    }
+    if (h->n > 0)
+        h->b[i] = last;
+    return top;
+}
+
+/*
+ * Trace generation
+ */
+static void emit_alloc(gen_t *g, block_t *b) {
+    g->live_bytes += b->size;
+    if (g->live_bytes > g->peak_bytes)
+        g->peak_bytes = g->live_bytes;
+    if (g->out)
+        fprintf(g->out, "a %d %zu\n", b->id, b->size);
+    g->ops++;
+}
+
+static void emit_realloc(gen_t *g, block_t *b, size_t size) {
+    g->live_bytes += size - b->size;
+    b->size = size;
+    if (g->live_bytes > g->peak_bytes)
+        g->peak_bytes = g->live_bytes;
+    if (g->out)
+        fprintf(g->out, "r %d %zu\n", b->id, size);
+    g->ops++;
+}
+
+static void emit_free(gen_t *g, block_t *b) {
+    g->live_bytes -= b->size;
+    if (g->out)
+        fprintf(g->out, "f %d\n", b->id);
+    g->ops++;
+}
+
+/* Free the blocks due soonest until adding bytes stays within peak */
+static void make_room(gen_t *g, heap_t *h, size_t bytes, double peak) {
+    while (peak > 0.0 && h->n > 0 && g->live_bytes + bytes > peak) {
+        block_t b = heap_pop(h);
+        emit_free(g, &b);
+    }
+}
+
+/* Size from d: at least one byte */
+static size_t draw_size(const dist_t *d) {
+    double s = dist_sample(d);
+
+    return s < 1.0 ? 1 : s > 1e15 ? (size_t) 1e15 : (size_t) s;
+}
+
+/* Lifetime from d, scaled: at least one allocation */
+static uint64_t draw_life(const dist_t *d) {
+    double l = dist_sample(d) * scale;
+
+    return l < 1.0 ? 1 : l >= 1e18 ? FOREVER : (uint64_t) l;
+}
+
+/* Generate all phases into g; the same seed gives the same trace */
+static void generate(gen_t *g, uint64_t seed) {
+    heap_t h = { NULL, 0, 0 };
+    uint64_t now = 0;
+    int i;
+
+    rng_state = seed;
+    for (i = 0; i < num_phases; i++) {
+        const phase_t *p = &phases[i];
+        long n = (long) (p->n * scale);
+        double peak = p->peak * scale;
+
+        for (long k = 0; k < n; k++, now++) {
+            block_t b;
+            uint64_t life;
+
+            /* Reallocs and frees that are due */
+            while (h.n > 0 && h.b[0].due <= now) {
+                b = heap_pop(&h);
+                if (b.steps_left > 0) {
+                    size_t size = (size_t) (b.size * b.grow);
+                    if (size < 1)
+                        size = 1;
+                    if (size > b.size)
+                        make_room(g, &h, size - b.size, peak);
+                    emit_realloc(g, &b, size);
+                    b.steps_left--;
+                    b.due += b.interval;
+                    heap_push(&h, &b);
+                } else {
+                    emit_free(g, &b);
+                }
+            }
+
+            b.size = draw_size(&p->size);
+            life = draw_life(&p->life);
+            b.id = (int) g->ids++;
+            b.due = life == FOREVER ? FOREVER : now + life;
+            b.steps_left = 0;
+            b.interval = 0;
+            b.grow = p->grow;
+            if (p->steps > 0 && life != FOREVER && rng_unit() < p->realloc_frac) {
+                b.interval = life / (p->steps + 1);
+                if (b.interval > 0) {
+                    b.steps_left = p->steps;
+                    b.due = now + b.interval;
+                }
+            }
+            make_room(g, &h, b.size, peak);
+            emit_alloc(g, &b);
+            heap_push(&h, &b);
+        }
+    }
+
+    /* Free what is left, in the order it is due */
+    while (h.n > 0) {
+        block_t b = heap_pop(&h);
+        emit_free(g, &b);
+    }
+    free(h.b);
+}
+
+static void usage(char *prog) {
+    fprintf(stderr, "Usage: %s [-h] [-o <file>] [-s <seed>] [-w <weight>] [-x <scale>] -p <phase> ...\n", prog);
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-o <file>   Write the trace to <file> instead of stdout.\n");
+    fprintf(stderr, "\t-p <phase>  Add a phase, e.g. n=10k,size=pow:16:4k:1.5,life=exp:500\n");
+    fprintf(stderr, "\t            (other keys: realloc, grow, steps, peak; see tracegen.c).\n");
+    fprintf(stderr, "\t-s <seed>   Seed of the random numbers (default 1).\n");
+    fprintf(stderr, "\t-w <weight> Weight in the trace header (default 1).\n");
+    fprintf(stderr, "\t-x <scale>  Scale counts, lifetimes and peaks.\n");
+}
+
+int main(int argc, char **argv) {
+    /* Defaults of the first phase */
+    phase_t cur = { 0, { DIST_POW, 16, 4096, 1.5, 0, {0}, {0} },
+                    { DIST_EXP, 1000, 0, 0, 0, {0}, {0} }, 0.0, 2.0, 4, 0.0 };
+    uint64_t seed = 1;
+    int weight = 1;
+    char *outname = NULL;
+    gen_t g;
+    int c;
+
+    while ((c = getopt(argc, argv, "ho:p:s:w:x:")) != EOF) {
+        switch (c) {
+            case 'o':
+                outname = optarg;
+                break;
+            case 'p':
+                if (num_phases == PHASES_MAX)
+                    app_error("too many phases", NULL);
+                if (!parse_phase(optarg, &cur))
+                    app_error("bad phase", optarg);
+                phases[num_phases++] = cur;
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'w':
+                weight = atoi(optarg);
+                if (weight < 0 || weight > 3)
+                    app_error("bad weight", optarg);
+                break;
+            case 'x':
+                if (!parse_value(optarg, optarg + strlen(optarg), &scale) || scale <= 0.0)
+                    app_error("bad scale", optarg);
+                break;
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+    if (num_phases == 0)
+        app_error("no phases given", NULL);
+
+    /* A counting pass for the header, then the real one */
+    memset(&g, 0, sizeof(g));
+    generate(&g, seed);
+    if (g.ids > INT32_MAX || g.ops > INT32_MAX)
+        app_error("trace too large", NULL);
+    if (outname != NULL && (g.out = fopen(outname, "w")) == NULL)
+        app_error("could not create", outname);
+    if (outname == NULL)
+        g.out = stdout;
+    fprintf(g.out, "%d\n%ld\n%ld\n%zu\n", weight, g.ids, g.ops, g.peak_bytes);
+    g.ops = 0;
+    g.ids = 0;
+    g.live_bytes = g.peak_bytes = 0;
+    generate(&g, seed);
+    if (fclose(g.out) != 0)
+        app_error("could not write", outname ? outname : "stdout");
+    fprintf(stderr, "tracegen: %ld blocks, %ld requests, peak %zu bytes\n",
+            g.ids, g.ops, g.peak_bytes);
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Welch's t-test, see ttest.h
+ */
+
+#include <stddef.h>
+#include <math.h>
+#include "ttest.h"
+
+#define BETA_ITERS 200
+#define BETA_EPS   1e-12
+#define BETA_TINY  1e-300
+
+void ttest_moments(const double *x, int n, double *mean, double *var)
+{
+    double sum = 0.0, ss = 0.0;
+    int i;
+
+    for (i = 0; i < n; i++)
+        sum += x[i];
+    *mean = n > 0 ? sum / n : 0.0;
+    for (i = 0; i < n; i++)
+        ss += (x[i] - *mean) * (x[i] - *mean);
+    *var = n > 1 ? ss / (n - 1) : 0.0;
+}
+
+/* Continued fraction of the incomplete beta function (Lentz's method) */
+static double beta_cf(double a, double b, double x)
+{
+    double c = 1.0, d = 1.0 - (a + b) * x / (a + 1.0), h, aa, del;
+    int m;
+
+    if (fabs(d) < BETA_TINY)
+        d = BETA_TINY;
+    d = 1.0 / d;
+    h = d;
+    for (m = 1; m <= BETA_ITERS; m++) {
+        aa = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+        d = 1.0 + aa * d;
+        c = 1.0 + aa / c;
+        if (fabs(d) < BETA_TINY)
+            d = BETA_TINY;
+        if (fabs(c) < BETA_TINY)
+            c = BETA_TINY;
+        d = 1.0 / d;
+        h *= d * c;
+        aa = -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+        d = 1.0 + aa * d;
+        c = 1.0 + aa / c;
+        if (fabs(d) < BETA_TINY)
+            d = BETA_TINY;
+        if (fabs(c) < BETA_TINY)
+            c = BETA_TINY;
+        d = 1.0 / d;
+        del = d * c;
+        h *= del;
+        if (fabs(del - 1.0) < BETA_EPS)
+            break;
+    }
+    return h;
+}
+
+/* Regularized incomplete beta function I_x(a, b) */
+static double beta_inc(double a, double b, double x)
+{
+    double front;
+
+    if (x <= 0.0)
+        return 0.0;
+    if (x >= 1.0)
+        return 1.0;
+    front = exp(lgamma(a + b) - lgamma(a) - lgamma(b)
+                + a * log(x) + b * log(1.0 - x));
+    if (x < (a + 1.0) / (a + b + 2.0))
+        return front * beta_cf(a, b, x) / a;
+    return 1.0 - front * beta_cf(b, a, 1.0 - x) / b;
+}
+
+double ttest_welch(const double *a, int na, const double *b, int nb, double *t)
+{
+    double ma, va, mb, vb, sa, sb, se2, tv, df;
+
+    if (na < 2 || nb < 2)
+        return -1.0;
+    ttest_moments(a, na, &ma, &va);
+    ttest_moments(b, nb, &mb, &vb);
+    sa = va / na;
+    sb = vb / nb;
+    se2 = sa + sb;
+    if (se2 == 0.0) {
+        /* No spread at all: the means either match or they don't */
+        if (t != NULL)
+            *t = ma == mb ? 0.0 : ma > mb ? INFINITY : -INFINITY;
+        return ma == mb ? 1.0 : 0.0;
+    }
+    tv = (ma - mb) / sqrt(se2);
+    /* Welch-Satterthwaite degrees of freedom */
+    df = se2 * se2 / (sa * sa / (na - 1) + sb * sb / (nb - 1));
+    if (t != NULL)
+        *t = tv;
+    /* P(|T| > |t|) for Student's t with df degrees of freedom */
+    return beta_inc(df / 2.0, 0.5, df / (df + tv * tv));
+}
@@ -0,0 +1,21 @@
+/*
+ * Welch's t-test, for comparing throughput samples of two runs
+ *
+ * Unlike Student's test, it doesn't assume that both samples have the
+ * same variance, which timing samples from different builds or days
+ * seldom do.
+ */
+#ifndef TTEST_H_
+#define TTEST_H_
+
+/* Mean and sample variance of the n values of x (variance 0 if n < 2) */
+void ttest_moments(const double *x, int n, double *mean, double *var);
+
+/*
+ * Two-sided p-value of the hypothesis that a and b have the same mean.
+ * Both need at least two values; returns -1 otherwise.  If t is not
+ * NULL, the t statistic is stored there (positive if a's mean is larger).
+ */
+double ttest_welch(const double *a, int na, const double *b, int nb, double *t);
+
+#endif /* TTEST_H_ */